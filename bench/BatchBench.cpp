@@ -0,0 +1,76 @@
+#include "Bench.h"
+#include "LinuxPolicy.h"
+
+// Items/sec of Perform + per-item callback versus PerformBatch + span callback.
+// Usage: BatchBench [items] [threads]
+
+using BenchPolicy = AsyncWorkPolicy
+<
+    Data,
+    PriorityQueue,
+    LinuxLock,
+    ScopedLocker,
+    LinuxSynchronizer<>,
+    LinuxThreadPool<>,
+    BenchThreadNumber
+>;
+
+double RunPerItem(const std::vector < BenchPolicy::DataPtrType >& items)
+{
+    CompletionCounter done;
+    BenchPolicy policy([&done](BenchPolicy::DataPtrType) { done.Add(); });
+
+    Stopwatch sw;
+    for (const BenchPolicy::DataPtrType& d : items)
+        policy.Perform(d);
+
+    done.WaitFor(static_cast < long >(items.size()));
+    return sw.Seconds();
+}
+
+double RunBatched(const std::vector < BenchPolicy::DataPtrType >& items, int batchSize)
+{
+    CompletionCounter done;
+    BenchPolicy policy([&done](ItemSpan < BenchPolicy::DataPtrType > batch) { done.Add(batch.size()); }, batchSize);
+
+    Stopwatch sw;
+    for (size_t i = 0; i < items.size(); i += batchSize)
+    {
+        size_t last = std::min(items.size(), i + batchSize);
+        policy.PerformBatch(items.begin() + i, items.begin() + last);
+    }
+
+    done.WaitFor(static_cast < long >(items.size()));
+    return sw.Seconds();
+}
+
+int main(int argc, char* argv[])
+{
+    long count = ArgOr(argc, argv, 1, 200000);
+    BenchThreadNumber::Count() = static_cast < int >(ArgOr(argc, argv, 2, BenchThreadNumber::Get()));
+
+    std::vector < BenchPolicy::DataPtrType > items;
+    items.reserve(count);
+    for (long i = 0; i < count; ++i)
+        items.push_back(std::make_shared < Data >(i, i, static_cast < int >(i % 1000)));
+
+    std::printf("mode,batch,threads,items,seconds,items_per_sec\n");
+
+    double seconds = 0;
+    {
+        QuietOutput quiet;
+        seconds = RunPerItem(items);
+    }
+    std::printf("per_item,1,%d,%ld,%.6f,%.0f\n", BenchThreadNumber::Get(), count, seconds, count / seconds);
+
+    for (int batchSize : { 1, 4, 16, 64, 256, 1024 })
+    {
+        {
+            QuietOutput quiet;
+            seconds = RunBatched(items, batchSize);
+        }
+        std::printf("batched,%d,%d,%ld,%.6f,%.0f\n", batchSize, BenchThreadNumber::Get(), count, seconds, count / seconds);
+    }
+
+    return 0;
+}
@@ -0,0 +1,125 @@
+#if !defined( __BENCH_H__ )
+#define __BENCH_H__
+
+#if !defined( DEBUG_MODE )
+#define DEBUG_MODE 0
+#endif // DEBUG_MODE
+
+#include "Policy.h"
+
+#include <chrono>
+#include <fcntl.h>
+
+// Worker count chosen at run time, so one binary can sweep thread counts.
+struct BenchThreadNumber
+{
+    static int& Count()
+    {
+        static int s_count = static_cast < int >(std::thread::hardware_concurrency());
+        return s_count;
+    }
+
+    static int Get()
+    {
+        return Count();
+    }
+};
+
+// Same shape as Data, but without a heap-allocated trace string.
+class BenchData
+{
+    int m_a;
+    int m_b;
+    int m_p;
+public:
+    BenchData(int a, int b, int p) : m_a(a), m_b(b), m_p(p) {}
+
+    int GetPriority() const { return m_p; }
+    std::string Printout() const { return std::string(); }
+};
+
+class Stopwatch
+{
+    std::chrono::steady_clock::time_point m_start;
+public:
+    Stopwatch() : m_start(std::chrono::steady_clock::now()) {}
+
+    double Seconds() const
+    {
+        return std::chrono::duration < double >(std::chrono::steady_clock::now() - m_start).count();
+    }
+};
+
+inline long long NowNs()
+{
+    return std::chrono::duration_cast < std::chrono::nanoseconds >(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Sorts the samples in place; q in [0, 1].
+inline long long Percentile(std::vector < long long >& samples, double q)
+{
+    if (samples.empty()) return 0;
+
+    std::sort(std::begin(samples), std::end(samples));
+    size_t index = static_cast < size_t >(q * (samples.size() - 1) + 0.5);
+    return samples[index];
+}
+
+// The policies log through Logger; benchmarks only want their own report.
+// The null device stays open for good, other threads may still log meanwhile.
+class QuietOutput
+{
+    int m_saved;
+public:
+    static int Null()
+    {
+#if defined( __linux__ )
+        static int s_null = open("/dev/null", O_WRONLY);
+#else
+        static int s_null = _open("NUL", _O_WRONLY);
+#endif // __linux__
+        return s_null;
+    }
+
+    QuietOutput() : m_saved(Logger::Instance().SetDescriptor(Null())) {}
+    ~QuietOutput() { Logger::Instance().Sync(); Logger::Instance().SetDescriptor(m_saved); }
+};
+
+// Points the stdout descriptor at the null device for a benchmark writing to
+// std::cout itself; cout keeps its stdio-synced buffer, which threads may share.
+class QuietStdout
+{
+    int m_saved;
+public:
+#if defined( __linux__ )
+    QuietStdout() : m_saved((std::fflush(stdout), dup(STDOUT_FILENO))) { dup2(QuietOutput::Null(), STDOUT_FILENO); }
+    ~QuietStdout() { std::cout.flush(); std::fflush(stdout); dup2(m_saved, STDOUT_FILENO); close(m_saved); }
+#else
+    QuietStdout() : m_saved((std::fflush(stdout), _dup(_fileno(stdout)))) { _dup2(QuietOutput::Null(), _fileno(stdout)); }
+    ~QuietStdout() { std::cout.flush(); std::fflush(stdout); _dup2(m_saved, _fileno(stdout)); _close(m_saved); }
+#endif // __linux__
+};
+
+// What a callback wrote before Add is visible to the thread WaitFor returns on.
+class CompletionCounter
+{
+    std::atomic < long > m_done;
+public:
+    CompletionCounter() : m_done(0) {}
+
+    void Add(long count = 1) { m_done.fetch_add(count, std::memory_order_release); }
+
+    void WaitFor(long total) const
+    {
+        while (m_done.load(std::memory_order_acquire) < total)
+            std::this_thread::yield();
+    }
+};
+
+inline long ArgOr(int argc, char* argv[], int index, long fallback)
+{
+    return (argc > index) ? std::strtol(argv[index], nullptr, 10) : fallback;
+}
+
+#endif // __BENCH_H__
@@ -0,0 +1,78 @@
+#include "Bench.h"
+#include "LinuxPolicy.h"
+
+#include <sys/resource.h>
+
+// Producers outrunning slow workers: items accepted and dropped under each
+// overflow mode of a bounded queue, and the process peak RSS. The unbounded
+// queue runs last since the peak RSS only ever grows.
+// Usage: BoundedBench [items] [callback ns] [threads]
+
+constexpr size_t Capacity = 4096;
+
+template < template < typename > typename QueueType >
+using BenchPolicy = AsyncWorkPolicy
+<
+    BenchData,
+    QueueType,
+    LinuxLock,
+    ScopedLocker,
+    LinuxSynchronizer<>,
+    LinuxThreadPool<>,
+    BenchThreadNumber
+>;
+
+long PeakRssKb()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+template < template < typename > typename QueueType >
+void Run(const char* name, long count, long callbackNs)
+{
+    using PolicyType = BenchPolicy < QueueType >;
+
+    long accepted = 0;
+    unsigned long dropped = 0;
+    double seconds = 0;
+    {
+        CompletionCounter done;
+        QuietOutput quiet;
+        PolicyType policy([&done, callbackNs](const typename PolicyType::DataPtrType&)
+        {
+            long long until = NowNs() + callbackNs;
+            while (NowNs() < until);
+            done.Add();
+        });
+
+        Stopwatch sw;
+        for (long i = 0; i < count; ++i)
+            accepted += policy.Emplace(static_cast < int >(i), static_cast < int >(i), static_cast < int >(i % 1000)) ? 1 : 0;
+
+        // Drop modes discard exactly one item per offer to a full queue, the offered or an evicted one.
+        dropped = policy.Dropped();
+        bool dropping = PolicyType::OverflowMode == Overflow::DropLowest || PolicyType::OverflowMode == Overflow::DropNew;
+        done.WaitFor(dropping ? count - static_cast < long >(dropped) : accepted);
+        seconds = sw.Seconds();
+    }
+
+    std::printf("%s,%d,%ld,%ld,%lu,%.6f,%ld\n", name, BenchThreadNumber::Get(), count, accepted, dropped, seconds, PeakRssKb());
+}
+
+int main(int argc, char* argv[])
+{
+    long count = ArgOr(argc, argv, 1, 200000);
+    long callbackNs = ArgOr(argc, argv, 2, 1000);
+    BenchThreadNumber::Count() = static_cast < int >(ArgOr(argc, argv, 3, BenchThreadNumber::Get()));
+
+    std::printf("mode,threads,offered,accepted,dropped,seconds,peak_rss_kb\n");
+    Run < Bounded < Capacity, Overflow::Block >::Queue >("block", count, callbackNs);
+    Run < Bounded < Capacity, Overflow::FailFast >::Queue >("fail_fast", count, callbackNs);
+    Run < Bounded < Capacity, Overflow::DropLowest >::Queue >("drop_lowest", count, callbackNs);
+    Run < Bounded < Capacity, Overflow::DropNew >::Queue >("drop_new", count, callbackNs);
+    Run < PriorityQueue >("unbounded", count, callbackNs);
+
+    return 0;
+}
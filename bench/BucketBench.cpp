@@ -0,0 +1,68 @@
+#include "Bench.h"
+#include "LinuxPolicy.h"
+
+// Nanoseconds per Enqueue + Dequeue of the bucketed queue against the binary
+// heap PriorityQueue, for 10, 1000 and 65536 priority levels: once filling up
+// and draining a deep queue, once holding a steady depth.
+// Usage: BucketBench [depth] [operations]
+
+template < typename QueueType >
+double FillDrain(const std::vector < int >& priorities)
+{
+    QueueType queue;
+    int i = 0;
+
+    Stopwatch sw;
+    for (int p : priorities)
+        queue.Enqueue(std::make_shared < BenchData >(i, i, p)), ++i;
+
+    for (size_t n = 0; n < priorities.size(); ++n)
+        if (!queue.Dequeue()) std::abort();
+
+    return sw.Seconds() * 1e9 / priorities.size();
+}
+
+template < typename QueueType >
+double Steady(const std::vector < int >& priorities, size_t depth, long operations)
+{
+    QueueType queue;
+    for (size_t n = 0; n < depth; ++n)
+        queue.Enqueue(std::make_shared < BenchData >(0, 0, priorities[n % priorities.size()]));
+
+    Stopwatch sw;
+    for (long n = 0; n < operations; ++n)
+    {
+        queue.Enqueue(std::make_shared < BenchData >(0, 0, priorities[n % priorities.size()]));
+        if (!queue.Dequeue()) std::abort();
+    }
+
+    return sw.Seconds() * 1e9 / operations;
+}
+
+template < size_t Levels >
+void Report(size_t depth, long operations)
+{
+    std::vector < int > priorities(depth);
+    std::generate(std::begin(priorities), std::end(priorities), []() { return static_cast < int >(FastRandom() % Levels); });
+
+    using HeapType = PriorityQueue < BenchData >;
+    using BucketType = typename Bucketed < Levels >::template Queue < BenchData >;
+
+    std::printf("heap,%zu,%zu,%.2f,%.2f\n", Levels, depth,
+        FillDrain < HeapType >(priorities), Steady < HeapType >(priorities, depth, operations));
+    std::printf("bucket,%zu,%zu,%.2f,%.2f\n", Levels, depth,
+        FillDrain < BucketType >(priorities), Steady < BucketType >(priorities, depth, operations));
+}
+
+int main(int argc, char* argv[])
+{
+    size_t depth = static_cast < size_t >(ArgOr(argc, argv, 1, 100000));
+    long operations = ArgOr(argc, argv, 2, 1000000);
+
+    std::printf("queue,levels,depth,fill_drain_ns_per_item,steady_ns_per_op\n");
+    Report < 10 >(depth, operations);
+    Report < 1000 >(depth, operations);
+    Report < 65536 >(depth, operations);
+
+    return 0;
+}
@@ -0,0 +1,87 @@
+#include "Bench.h"
+#include "LinuxPolicy.h"
+
+// Per-item overhead of a trivial handler held as std::function versus as the
+// policy's own CallbackType, first in an isolated dispatch loop, then end to end.
+// Usage: CallbackBench [items] [threads]
+
+struct TrivialHandler
+{
+    std::atomic < long >* done;
+
+    void operator()(BenchData&& d) const
+    {
+        if (d.GetPriority() >= 0)
+            done->fetch_add(1, std::memory_order_relaxed);
+    }
+};
+
+template < typename CallbackType >
+using BenchPolicy = AsyncWorkPolicy
+<
+    BenchData,
+    ValuePriorityQueue,
+    LinuxLock,
+    ScopedLocker,
+    LinuxSynchronizer<>,
+    LinuxThreadPool<>,
+    BenchThreadNumber,
+    CallbackType
+>;
+
+template < typename CallbackType >
+double Dispatch(const CallbackType& callback, std::vector < BenchData >& items)
+{
+    Stopwatch sw;
+    for (BenchData& d : items)
+        callback(std::move(d));
+
+    return sw.Seconds();
+}
+
+template < typename CallbackType >
+double EndToEnd(long count)
+{
+    std::atomic < long > done(0);
+    QuietOutput quiet;
+    BenchPolicy < CallbackType > policy(CallbackType(TrivialHandler { &done }));
+
+    Stopwatch sw;
+    for (long i = 0; i < count; ++i)
+        policy.Emplace(static_cast < int >(i), static_cast < int >(i), static_cast < int >(i % 1000));
+
+    while (done.load(std::memory_order_relaxed) < count)
+        std::this_thread::yield();
+
+    return sw.Seconds();
+}
+
+int main(int argc, char* argv[])
+{
+    using FunctionType = std::function < void (BenchData) >;
+
+    long count = ArgOr(argc, argv, 1, 1000000);
+    BenchThreadNumber::Count() = static_cast < int >(ArgOr(argc, argv, 2, BenchThreadNumber::Get()));
+
+    std::vector < BenchData > items;
+    items.reserve(count);
+    for (long i = 0; i < count; ++i)
+        items.emplace_back(static_cast < int >(i), static_cast < int >(i), static_cast < int >(i % 1000));
+
+    std::atomic < long > done(0);
+    std::printf("stage,callback,threads,items,seconds,ns_per_item\n");
+
+    double seconds = Dispatch(FunctionType(TrivialHandler { &done }), items);
+    std::printf("dispatch,std_function,1,%ld,%.6f,%.2f\n", count, seconds, seconds * 1e9 / count);
+
+    seconds = Dispatch(TrivialHandler { &done }, items);
+    std::printf("dispatch,static,1,%ld,%.6f,%.2f\n", count, seconds, seconds * 1e9 / count);
+
+    seconds = EndToEnd < FunctionType >(count);
+    std::printf("policy,std_function,%d,%ld,%.6f,%.2f\n", BenchThreadNumber::Get(), count, seconds, seconds * 1e9 / count);
+
+    seconds = EndToEnd < TrivialHandler >(count);
+    std::printf("policy,static,%d,%ld,%.6f,%.2f\n", BenchThreadNumber::Get(), count, seconds, seconds * 1e9 / count);
+
+    return 0;
+}
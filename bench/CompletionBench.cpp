@@ -0,0 +1,218 @@
+#include "Bench.h"
+#include "LinuxPolicy.h"
+
+#include <future>
+
+// Cost of getting results back: fire-and-forget Perform with a shared counter,
+// Submit with Completion handles, and items carrying a std::promise. Results are
+// collected in windows of the given size, below the completion pool capacity.
+// The *_clients rows split the items over client threads that each submit one
+// item and block on its result, so many waiters sleep on different handles.
+// Usage: CompletionBench [items] [window] [clients]
+
+using CompletableData = Completable < BenchData, int >;
+
+using CompletionPolicyType = AsyncWorkPolicy
+<
+    CompletableData,
+    PriorityQueue,
+    LinuxLock,
+    ScopedLocker,
+    LinuxSynchronizer<>,
+    LinuxThreadPool<>,
+    BenchThreadNumber,
+    std::function < int (std::shared_ptr < CompletableData >) >
+>;
+
+struct PromisedData : BenchData
+{
+    std::promise < int > result;
+
+    PromisedData(int a, int b, int p) : BenchData(a, b, p) {}
+};
+
+using PromisePolicyType = AsyncWorkPolicy
+<
+    PromisedData,
+    PriorityQueue,
+    LinuxLock,
+    ScopedLocker,
+    LinuxSynchronizer<>,
+    LinuxThreadPool<>,
+    BenchThreadNumber
+>;
+
+using PerformPolicyType = AsyncWorkPolicy
+<
+    BenchData,
+    PriorityQueue,
+    LinuxLock,
+    ScopedLocker,
+    LinuxSynchronizer<>,
+    LinuxThreadPool<>,
+    BenchThreadNumber
+>;
+
+void Report(const char* mode, long count, double seconds, long sum)
+{
+    std::printf("%s,%d,%ld,%.0f,%.1f,%ld\n", mode, BenchThreadNumber::Get(), count, count / seconds,
+        seconds * 1e9 / count, sum);
+    std::fflush(stdout);
+}
+
+void RunPerform(long count, long window)
+{
+    CompletionCounter done;
+    std::atomic < long > sum(0);
+    PerformPolicyType policy([&done, &sum](const PerformPolicyType::DataPtrType& d)
+    {
+        sum.fetch_add(d->GetPriority(), std::memory_order_relaxed);
+        done.Add();
+    });
+
+    Stopwatch watch;
+    for (long i = 0; i < count; i += window)
+    {
+        long end = std::min(count, i + window);
+        for (long j = i; j < end; ++j)
+            policy.Emplace(static_cast < int >(j), 0, static_cast < int >(j % 1000));
+
+        done.WaitFor(end);
+    }
+
+    Report("perform", count, watch.Seconds(), sum.load());
+}
+
+void RunSubmit(long count, long window)
+{
+    CompletionPolicyType policy([](std::shared_ptr < CompletableData > d)
+    {
+        return d->GetPriority();
+    });
+
+    std::vector < CompletionPolicyType::CompletionType > completions;
+    completions.reserve(window);
+
+    long sum = 0;
+    Stopwatch watch;
+    for (long i = 0; i < count; i += window)
+    {
+        long end = std::min(count, i + window);
+        for (long j = i; j < end; ++j)
+            completions.push_back(policy.Submit(policy.Make(static_cast < int >(j), 0, static_cast < int >(j % 1000))));
+
+        WaitAll(std::begin(completions), std::end(completions));
+        for (const CompletionPolicyType::CompletionType& completion : completions)
+            sum += completion.Get();
+
+        completions.clear();
+    }
+
+    Report("submit", count, watch.Seconds(), sum);
+}
+
+void RunPromise(long count, long window)
+{
+    PromisePolicyType policy([](const PromisePolicyType::DataPtrType& d)
+    {
+        d->result.set_value(d->GetPriority());
+    });
+
+    std::vector < std::future < int > > futures;
+    futures.reserve(window);
+
+    long sum = 0;
+    Stopwatch watch;
+    for (long i = 0; i < count; i += window)
+    {
+        long end = std::min(count, i + window);
+        for (long j = i; j < end; ++j)
+        {
+            PromisePolicyType::DataPtrType d = policy.Make(static_cast < int >(j), 0, static_cast < int >(j % 1000));
+            futures.push_back(d->result.get_future());
+            policy.Perform(std::move(d));
+        }
+
+        for (std::future < int >& future : futures)
+            sum += future.get();
+
+        futures.clear();
+    }
+
+    Report("promise", count, watch.Seconds(), sum);
+}
+
+template < typename RoundTripType >
+long RunClients(long count, long clients, RoundTripType roundTrip)
+{
+    std::atomic < long > sum(0);
+    std::vector < std::thread > threads;
+    for (long c = 0; c < clients; ++c)
+    {
+        threads.emplace_back([&sum, &roundTrip, c, count, clients]()
+        {
+            long local = 0;
+            for (long j = c; j < count; j += clients)
+                local += roundTrip(static_cast < int >(j % 1000));
+
+            sum.fetch_add(local);
+        });
+    }
+
+    for (std::thread& thread : threads)
+        thread.join();
+
+    return sum.load();
+}
+
+void RunSubmitClients(long count, long clients)
+{
+    CompletionPolicyType policy([](std::shared_ptr < CompletableData > d)
+    {
+        return d->GetPriority();
+    });
+
+    Stopwatch watch;
+    long sum = RunClients(count, clients, [&policy](int p)
+    {
+        return policy.Submit(policy.Make(p, 0, p)).Get();
+    });
+
+    Report("submit_clients", count, watch.Seconds(), sum);
+}
+
+void RunPromiseClients(long count, long clients)
+{
+    PromisePolicyType policy([](const PromisePolicyType::DataPtrType& d)
+    {
+        d->result.set_value(d->GetPriority());
+    });
+
+    Stopwatch watch;
+    long sum = RunClients(count, clients, [&policy](int p)
+    {
+        PromisePolicyType::DataPtrType d = policy.Make(p, 0, p);
+        std::future < int > future = d->result.get_future();
+        policy.Perform(std::move(d));
+        return future.get();
+    });
+
+    Report("promise_clients", count, watch.Seconds(), sum);
+}
+
+int main(int argc, char* argv[])
+{
+    long count = ArgOr(argc, argv, 1, 1000000);
+    long window = std::min(ArgOr(argc, argv, 2, 1024), static_cast < long >(CompletionPool < int >::DefaultCapacity));
+    long clients = ArgOr(argc, argv, 3, 16);
+
+    QuietOutput quiet;
+    std::printf("mode,threads,items,items_per_s,ns_per_item,checksum\n");
+    RunPerform(count, window);
+    RunSubmit(count, window);
+    RunPromise(count, window);
+    RunSubmitClients(count / 10, clients);
+    RunPromiseClients(count / 10, clients);
+
+    return 0;
+}
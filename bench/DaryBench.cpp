@@ -0,0 +1,47 @@
+#include "Bench.h"
+#include "LinuxPolicy.h"
+
+// Nanoseconds per Dequeue + Enqueue at a steady queue depth, growing the depth
+// into the millions, for the binary heap PriorityQueue against the 4-ary and
+// 8-ary heaps with inline keys. The items are made up front and scattered over
+// the heap, so deep queues pay for every cache miss a sift step takes.
+// Usage: DaryBench [max depth] [operations]
+
+template < typename QueueType >
+double Steady(const std::vector < std::shared_ptr < BenchData > >& items, size_t depth, long operations)
+{
+    QueueType queue;
+    for (size_t n = 0; n < depth; ++n)
+        queue.Enqueue(items[n]);
+
+    Stopwatch sw;
+    for (long n = 0; n < operations; ++n)
+    {
+        if (!queue.Dequeue()) std::abort();
+        queue.Enqueue(items[(depth + n) % items.size()]);
+    }
+
+    return sw.Seconds() * 1e9 / operations;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t maxDepth = static_cast < size_t >(ArgOr(argc, argv, 1, 4000000));
+    long operations = ArgOr(argc, argv, 2, 1000000);
+
+    std::vector < std::shared_ptr < BenchData > > items(maxDepth * 2);
+    for (std::shared_ptr < BenchData >& item : items)
+        item = std::make_shared < BenchData >(0, 0, static_cast < int >(FastRandom() % 1000000));
+
+    std::printf("depth,binary_ns_per_op,dary4_ns_per_op,dary8_ns_per_op\n");
+    for (size_t depth = 1000; depth <= maxDepth; depth *= 4)
+    {
+        std::printf("%zu,%.2f,%.2f,%.2f\n", depth,
+            Steady < PriorityQueue < BenchData > >(items, depth, operations),
+            Steady < DaryHeap < 4 >::Queue < BenchData > >(items, depth, operations),
+            Steady < DaryHeap < 8 >::Queue < BenchData > >(items, depth, operations));
+        std::fflush(stdout);
+    }
+
+    return 0;
+}
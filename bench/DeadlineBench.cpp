@@ -0,0 +1,100 @@
+#include "Bench.h"
+#include "LinuxPolicy.h"
+
+// Starvation under sustained overload: for 200ms producers offer 120% of what
+// the workers can do, nine in ten items at priority 900 and the rest at 10, each
+// callback busy for 5us. Reports per class queue latency and deadline misses
+// for strict priority, aging and earliest deadline first.
+// Usage: DeadlineBench [duration ms]
+
+class ClassData
+{
+    int m_index;
+    int m_p;
+public:
+    ClassData(int index, int p) : m_index(index), m_p(p) {}
+
+    int Index() const { return m_index; }
+    int GetPriority() const { return m_p; }
+    std::string Printout() const { return std::string(); }
+};
+
+using DeadlineData = Deadlined < Stamped < ClassData > >;
+
+constexpr long long CallbackNs = 5000;
+constexpr int HighPriority = 900;
+constexpr int LowPriority = 10;
+
+template < template < typename > typename QueueType >
+void Run(const char* mode, long durationMs)
+{
+    using PolicyType = AsyncWorkPolicy
+    <
+        DeadlineData,
+        QueueType,
+        LinuxLock,
+        ScopedLocker,
+        LinuxSynchronizer<>,
+        LinuxThreadPool<>,
+        BenchThreadNumber
+    >;
+
+    long perMs = static_cast < long >(1.2 * BenchThreadNumber::Get() * 1000000 / CallbackNs);
+    long count = perMs * durationMs;
+
+    std::vector < long long > latency(count);
+    CompletionCounter done;
+    std::atomic < long > missed[2] = { { 0 }, { 0 } };
+
+    PolicyType policy([&](const typename PolicyType::DataPtrType& d)
+    {
+        long long start = MonotonicNs();
+        latency[static_cast < size_t >(d->Index())] = start - d->GetEnqueueTime();
+        if (start > d->GetDeadline())
+            missed[d->GetPriority() == HighPriority ? 0 : 1].fetch_add(1, std::memory_order_relaxed);
+
+        while (MonotonicNs() - start < CallbackNs) {}
+        done.Add();
+    });
+
+    long long begin = MonotonicNs();
+    for (long i = 0; i < count; ++i)
+    {
+        // Keep to the offered rate rather than queueing everything up front.
+        while (MonotonicNs() - begin < i * 1000000 / perMs)
+            std::this_thread::yield();
+
+        bool low = (i % 10) == 9;
+        typename PolicyType::DataPtrType d = policy.Make(static_cast < int >(i), low ? LowPriority : HighPriority);
+        d->SetDeadlineAfter(std::chrono::milliseconds(low ? 50 : 20));
+        policy.Perform(std::move(d));
+    }
+
+    done.WaitFor(count);
+
+    for (int c = 0; c < 2; ++c)
+    {
+        std::vector < long long > samples;
+        for (long i = 0; i < count; ++i)
+            if (((i % 10) == 9) == (c == 1)) samples.push_back(latency[i]);
+
+        long long p50 = Percentile(samples, 0.5);
+        long long p99 = Percentile(samples, 0.99);
+        std::printf("%s,%s,%zu,%.1f,%.1f,%.1f,%ld\n", mode, c ? "low" : "high", samples.size(),
+            p50 / 1e3, p99 / 1e3, samples.back() / 1e3, missed[c].load());
+    }
+
+    std::fflush(stdout);
+}
+
+int main(int argc, char* argv[])
+{
+    long duration = ArgOr(argc, argv, 1, 200);
+
+    std::printf("mode,class,items,p50_us,p99_us,max_us,deadline_missed\n");
+    Run < PriorityQueue >("priority", duration);
+    Run < EarliestDeadline < 10000 >::Queue >("aging_10us", duration);
+    Run < EarliestDeadline < 0 >::Queue >("edf", duration);
+
+    return 0;
+}
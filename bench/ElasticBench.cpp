@@ -0,0 +1,129 @@
+#include "Bench.h"
+#include "LinuxPolicy.h"
+
+#include <sys/resource.h>
+
+// Fixed pool of 2 * cores + 1 workers against an elastic pool of 1 to 64 workers,
+// once with CPU-bound callbacks and once with callbacks blocking for 200us.
+// Reports throughput, the peak worker count and context switches, then a
+// timeline sampled every 20ms through the run and 300ms of idling after it,
+// with the worker and idle counts and the context switches in each interval.
+// Usage: ElasticBench [items]
+
+struct FixedThreadNumber
+{
+    static int Get() { return (get_nprocs() << 1) + 1; }
+};
+
+using ElasticBenchThreadNumber = ElasticThreadNumber < 1, 64, 4, 500, 100 >;
+
+constexpr int SampleMs = 20;
+constexpr int IdleTailMs = 300;
+
+struct Sample
+{
+    long ms;
+    int workers;
+    int idle;
+    long switches;
+};
+
+std::vector < std::string > s_timeline;
+
+long ContextSwitches()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_nvcsw + usage.ru_nivcsw;
+}
+
+template < typename ThreadNumberType >
+void Run(const char* pool, const char* load, long count, bool blocking)
+{
+    using PolicyType = AsyncWorkPolicy
+    <
+        BenchData,
+        PriorityQueue,
+        LinuxLock,
+        ScopedLocker,
+        LinuxSynchronizer<>,
+        LinuxThreadPool<>,
+        ThreadNumberType
+    >;
+
+    CompletionCounter done;
+    long switches = ContextSwitches();
+    std::atomic < int > peak { 0 };
+    double seconds = 0;
+    std::vector < Sample > samples;
+    {
+        PolicyType policy([&done, blocking](const typename PolicyType::DataPtrType& d)
+        {
+            if (blocking)
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            else
+            {
+                volatile int sink = d->GetPriority();
+                for (int i = 0; i < 2000; ++i) sink = sink * 31 + i;
+            }
+            done.Add();
+        });
+
+        std::atomic < bool > sampling { true };
+        std::thread sampler([&policy, &samples, &sampling, &peak, switches]()
+        {
+            long long start = MonotonicNs();
+            long last = switches;
+            while (sampling.load())
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(SampleMs));
+                PoolStatus status = policy.Workers();
+                peak.store(std::max(peak.load(), status.workers));
+                long now = ContextSwitches();
+                samples.push_back(Sample { static_cast < long >((MonotonicNs() - start) / 1000000), status.workers, status.idle, now - last });
+                last = now;
+            }
+        });
+
+        Stopwatch sw;
+        for (long i = 0; i < count; ++i)
+        {
+            policy.Emplace(static_cast < int >(i), 0, static_cast < int >(i % 1000));
+            peak.store(std::max(peak.load(), policy.Workers().workers));
+        }
+
+        done.WaitFor(count);
+        seconds = sw.Seconds();
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(IdleTailMs));
+        sampling.store(false);
+        sampler.join();
+    }
+
+    std::printf("%s,%s,%ld,%.6f,%.0f,%d,%ld\n", pool, load, count, seconds, count / seconds, peak.load(), ContextSwitches() - switches);
+    std::fflush(stdout);
+
+    for (const Sample& sample : samples)
+    {
+        char row[128];
+        std::snprintf(row, sizeof(row), "%s,%s,%ld,%d,%d,%ld", pool, load, sample.ms, sample.workers, sample.idle, sample.switches);
+        s_timeline.push_back(row);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    long count = ArgOr(argc, argv, 1, 20000);
+
+    std::printf("pool,callback,items,seconds,items_per_sec,peak_workers,context_switches\n");
+    Run < FixedThreadNumber >("fixed", "cpu", count, false);
+    Run < ElasticBenchThreadNumber >("elastic", "cpu", count, false);
+    Run < FixedThreadNumber >("fixed", "blocking", count, true);
+    Run < ElasticBenchThreadNumber >("elastic", "blocking", count, true);
+
+    std::printf("\npool,callback,ms,workers,idle,context_switches\n");
+    for (const std::string& row : s_timeline)
+        std::printf("%s\n", row.c_str());
+
+    return 0;
+}
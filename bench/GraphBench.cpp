@@ -0,0 +1,121 @@
+#include "Bench.h"
+#include "LinuxPolicy.h"
+#include "TaskGraph.h"
+
+// Task graph overhead and scheduling. First the cost per node of rerunning one
+// frozen graph of empty callbacks, for a single chain and for a binary tree.
+// Then makespan for one chain of busy nodes next to as many independent busy
+// nodes as the workers can take alongside it, with nodes ranked by their
+// critical path and with every node at the same priority.
+// Usage: GraphBench [nodes] [runs] [busy us]
+
+class GraphData
+{
+    int m_index;
+    int m_p;
+public:
+    GraphData(int index, int p = 0) : m_index(index), m_p(p) {}
+
+    int Index() const { return m_index; }
+    int GetPriority() const { return m_p; }
+    std::string Printout() const { return std::string(); }
+};
+
+template < typename DataType >
+using GraphPolicy = AsyncWorkPolicy
+<
+    Completable < DataType >,
+    PriorityQueue,
+    LinuxLock,
+    ScopedLocker,
+    LinuxSynchronizer<>,
+    LinuxThreadPool<>,
+    BenchThreadNumber
+>;
+
+using RankedPolicy = GraphPolicy < Ranked < GraphData > >;
+using FlatPolicy = GraphPolicy < GraphData >;
+
+void RunOverhead(const char* shape, long nodes, long runs)
+{
+    RankedPolicy policy([](const RankedPolicy::DataPtrType&) {});
+    TaskGraph < RankedPolicy > graph(policy);
+
+    for (long i = 0; i < nodes; ++i)
+    {
+        graph.Add(policy.Make(static_cast < int >(i)));
+        if (!i) continue;
+
+        if (shape[0] == 'c')
+            graph.Precede(static_cast < int >(i - 1), static_cast < int >(i));
+        else
+            graph.Precede(static_cast < int >((i - 1) / 2), static_cast < int >(i));
+    }
+
+    graph.Run();
+    graph.Wait();
+
+    Stopwatch watch;
+    for (long r = 0; r < runs; ++r)
+    {
+        graph.Run();
+        graph.Wait();
+    }
+    double seconds = watch.Seconds();
+
+    std::printf("overhead,%s,%d,%ld,%.1f\n", shape, BenchThreadNumber::Get(), nodes, seconds * 1e9 / (nodes * runs));
+    std::fflush(stdout);
+}
+
+template < typename PolicyType >
+void RunMakespan(const char* mode, long chain, long busyUs)
+{
+    long long busyNs = busyUs * 1000;
+    PolicyType policy([busyNs](const typename PolicyType::DataPtrType&)
+    {
+        long long start = MonotonicNs();
+        while (MonotonicNs() - start < busyNs) {}
+    });
+    TaskGraph < PolicyType > graph(policy);
+
+    // Independent work the other workers can overlap with the chain.
+    long side = chain * std::max(BenchThreadNumber::Get() - 1, 1);
+    for (long i = 0; i < side; ++i)
+        graph.Add(policy.Make(static_cast < int >(chain + i)));
+
+    int previous = -1;
+    for (long i = 0; i < chain; ++i)
+    {
+        int node = graph.Add(policy.Make(static_cast < int >(i)));
+        if (previous >= 0) graph.Precede(previous, node);
+        previous = node;
+    }
+
+    graph.Freeze();
+
+    Stopwatch watch;
+    graph.Run();
+    graph.Wait();
+    double seconds = watch.Seconds();
+
+    double ideal = static_cast < double >(chain) * busyNs / 1e9;
+    std::printf("makespan,%s,%d,%ld,%.2f,%.2f\n", mode, BenchThreadNumber::Get(), chain + side, seconds * 1e3, seconds / ideal);
+    std::fflush(stdout);
+}
+
+int main(int argc, char* argv[])
+{
+    long nodes = ArgOr(argc, argv, 1, 10000);
+    long runs = ArgOr(argc, argv, 2, 100);
+    long busy = ArgOr(argc, argv, 3, 50);
+
+    std::printf("overhead,shape,threads,nodes,ns_per_node\n");
+    RunOverhead("chain", nodes, runs);
+    RunOverhead("tree", nodes, runs);
+
+    std::printf("makespan,mode,threads,nodes,ms,vs_chain\n");
+    RunMakespan < RankedPolicy >("ranked", 200, busy);
+    RunMakespan < FlatPolicy >("flat", 200, busy);
+
+    return 0;
+}
@@ -0,0 +1,58 @@
+#include "Bench.h"
+#include "LinuxPolicy.h"
+
+// Cost of the instrumentation layer: throughput without it, with it on plain
+// items and with it on stamped items, plus the percentiles it collected.
+// Usage: InstrumentationBench [items] [threads]
+
+template < typename ItemType, typename InstrumentationType >
+using BenchPolicy = AsyncWorkPolicy
+<
+    ItemType,
+    ValuePriorityQueue,
+    LinuxLock,
+    ScopedLocker,
+    LinuxSynchronizer<>,
+    LinuxThreadPool<>,
+    BenchThreadNumber,
+    std::function < void (ItemType) >,
+    InstrumentationType
+>;
+
+template < typename ItemType, typename InstrumentationType >
+void Run(const char* name, long count)
+{
+    using PolicyType = BenchPolicy < ItemType, InstrumentationType >;
+
+    double seconds = 0;
+    std::string report;
+    {
+        CompletionCounter done;
+        QuietOutput quiet;
+        PolicyType policy([&done](ItemType) { done.Add(); });
+
+        Stopwatch sw;
+        for (long i = 0; i < count; ++i)
+            policy.Emplace(static_cast < int >(i), static_cast < int >(i), static_cast < int >(i % 100));
+
+        done.WaitFor(count);
+        seconds = sw.Seconds();
+        report = policy.Snapshot().Printout();
+    }
+
+    std::printf("%s,%d,%ld,%.6f,%.0f\n", name, BenchThreadNumber::Get(), count, seconds, count / seconds);
+    std::fprintf(stderr, "%s", report.c_str());
+}
+
+int main(int argc, char* argv[])
+{
+    long count = ArgOr(argc, argv, 1, 500000);
+    BenchThreadNumber::Count() = static_cast < int >(ArgOr(argc, argv, 2, BenchThreadNumber::Get()));
+
+    std::printf("instrumentation,threads,items,seconds,items_per_sec\n");
+    Run < BenchData, NoInstrumentation >("none", count);
+    Run < BenchData, LatencyInstrumentation<> >("counters", count);
+    Run < Stamped < BenchData >, LatencyInstrumentation<> >("stamped", count);
+
+    return 0;
+}
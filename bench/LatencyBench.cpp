@@ -0,0 +1,89 @@
+#include "Bench.h"
+#include "LinuxPolicy.h"
+#include "CrtPolicy.h"
+
+// Enqueue-to-callback latency under bursty traffic: bursts of items separated by
+// idle gaps, for parking and adaptive spinning synchronizers. CPU time shows
+// what the spinning costs.
+// Usage: LatencyBench [bursts] [burst size] [gap us] [threads]
+
+class TimedData
+{
+    int m_id;
+    int m_p;
+    long long m_stamp;
+public:
+    TimedData(int id, int p) : m_id(id), m_p(p), m_stamp(NowNs()) {}
+
+    int GetId() const { return m_id; }
+    int GetPriority() const { return m_p; }
+    long long GetStamp() const { return m_stamp; }
+    std::string Printout() const { return std::string(); }
+};
+
+template < typename SyncType >
+using BenchPolicy = AsyncWorkPolicy
+<
+    TimedData,
+    ValuePriorityQueue,
+    LinuxLock,
+    ScopedLocker,
+    SyncType,
+    LinuxThreadPool<>,
+    BenchThreadNumber
+>;
+
+template < typename SyncType >
+void Run(const char* name, long bursts, int burst, int gap)
+{
+    long count = bursts * burst;
+    std::vector < long long > latencies(count);
+
+    std::clock_t cpu = std::clock();
+    double seconds = 0;
+    {
+        CompletionCounter done;
+        QuietOutput quiet;
+        BenchPolicy < SyncType > policy([&](TimedData&& d)
+        {
+            latencies[d.GetId()] = NowNs() - d.GetStamp();
+            done.Add();
+        });
+
+        Stopwatch sw;
+        for (long b = 0; b < bursts; ++b)
+        {
+            for (int i = 0; i < burst; ++i)
+                policy.Emplace(static_cast < int >(b * burst + i), i);
+
+            std::this_thread::sleep_for(std::chrono::microseconds(gap));
+        }
+
+        done.WaitFor(count);
+        seconds = sw.Seconds();
+    }
+
+    double cpuSeconds = static_cast < double >(std::clock() - cpu) / CLOCKS_PER_SEC;
+    long long p50 = Percentile(latencies, 0.5);
+    long long p99 = Percentile(latencies, 0.99);
+    long long p999 = Percentile(latencies, 0.999);
+
+    std::printf("%s,%d,%d,%d,%ld,%.3f,%.3f,%.3f,%.3f,%.3f\n", name, BenchThreadNumber::Get(), burst, gap, count,
+        p50 / 1e3, p99 / 1e3, p999 / 1e3, seconds, cpuSeconds);
+}
+
+int main(int argc, char* argv[])
+{
+    long bursts = ArgOr(argc, argv, 1, 2000);
+    int burst = static_cast < int >(ArgOr(argc, argv, 2, 16));
+    int gap = static_cast < int >(ArgOr(argc, argv, 3, 20));
+    BenchThreadNumber::Count() = static_cast < int >(ArgOr(argc, argv, 4, BenchThreadNumber::Get()));
+
+    std::printf("sync,threads,burst,gap_us,items,p50_us,p99_us,p999_us,seconds,cpu_seconds\n");
+    Run < LinuxSynchronizer<> >("semaphore_park", bursts, burst, gap);
+    Run < LinuxSynchronizer < AdaptiveSpinWaitStrategy<> > >("semaphore_adaptive", bursts, burst, gap);
+    Run < CrtSynchronizer<> >("condvar_park", bursts, burst, gap);
+    Run < CrtSynchronizer < AdaptiveSpinWaitStrategy<> > >("condvar_adaptive", bursts, burst, gap);
+
+    return 0;
+}
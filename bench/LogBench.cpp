@@ -0,0 +1,80 @@
+#include "Bench.h"
+
+// Per-message cost on the logging threads of std::cout with std::endl versus the
+// asynchronous logger, both writing to /dev/null, for a growing number of threads.
+// By default the logger drops what its drain cannot keep up with instead of
+// stalling; the dropped column counts those messages, so that row only shows
+// the cost of a message that found room. The blocking row waits for the drain
+// instead, drops nothing and is the one to compare with std::cout.
+// Usage: LogBench [messages per thread] [max threads]
+
+class TracedData
+{
+    int m_a;
+    int m_b;
+    int m_p;
+public:
+    TracedData(int a, int b, int p) : m_a(a), m_b(b), m_p(p) {}
+
+    std::string Printout() const
+    {
+        std::stringstream sstm;
+        sstm << "{ a: " << m_a << ", b: " << m_b << ", priority: " << m_p << " }.";
+        return sstm.str();
+    }
+};
+
+template < typename FunType >
+double Run(int threads, long count, FunType&& fn)
+{
+    Stopwatch sw;
+    std::vector < std::thread > workers;
+    for (int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&fn, count, t]()
+        {
+            for (long i = 0; i < count; ++i)
+                fn(TracedData(static_cast < int >(i), t, static_cast < int >(i % 1000)));
+        });
+    }
+
+    std::for_each(std::begin(workers), std::end(workers), [](std::thread& th) { th.join(); });
+    return sw.Seconds();
+}
+
+int main(int argc, char* argv[])
+{
+    long count = ArgOr(argc, argv, 1, 100000);
+    int maxThreads = static_cast < int >(ArgOr(argc, argv, 2, std::thread::hardware_concurrency()));
+
+    QuietOutput quiet;
+
+    std::printf("sink,threads,messages,seconds,ns_per_message,dropped\n");
+    for (int threads = 1; threads <= maxThreads; threads <<= 1)
+    {
+        long total = count * threads;
+        double seconds = 0;
+        {
+            QuietStdout quietStdout;
+            seconds = Run(threads, count, [](const TracedData& d)
+            {
+                std::cout << "Enqueue entry - " << d.Printout() << std::endl;
+            });
+        }
+        std::printf("cout,%d,%ld,%.6f,%.2f,0\n", threads, total, seconds, seconds * 1e9 / total);
+
+        unsigned long dropped = Logger::Instance().Dropped();
+        seconds = Run(threads, count, [](const TracedData& d) { LogInfo("Enqueue entry - ", d); });
+        dropped = Logger::Instance().Dropped() - dropped;
+        std::printf("logger,%d,%ld,%.6f,%.2f,%lu\n", threads, total, seconds, seconds * 1e9 / total, dropped);
+
+        Logger::Instance().SetBlocking(true);
+        dropped = Logger::Instance().Dropped();
+        seconds = Run(threads, count, [](const TracedData& d) { LogInfo("Enqueue entry - ", d); });
+        dropped = Logger::Instance().Dropped() - dropped;
+        Logger::Instance().SetBlocking(false);
+        std::printf("blocking,%d,%ld,%.6f,%.2f,%lu\n", threads, total, seconds, seconds * 1e9 / total, dropped);
+    }
+
+    return 0;
+}
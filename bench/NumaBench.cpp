@@ -0,0 +1,94 @@
+#include "Bench.h"
+#include "LinuxPolicy.h"
+
+// Throughput of each worker placement, with the single-lock heap and with the
+// node-local shards. Producers are spread over the NUMA nodes and allocate their
+// own items, and the callback reads the whole payload, so items processed on a
+// remote node show up as lost throughput. Needs a multi-node host to differ.
+// Usage: NumaBench [items] [threads] [producers]
+
+class NumaData
+{
+    int m_p;
+    std::array < long long, 32 > m_payload;
+public:
+    NumaData(int id, int p) : m_p(p) { m_payload.fill(id); }
+
+    int GetPriority() const { return m_p; }
+    long long Sum() const { return std::accumulate(std::begin(m_payload), std::end(m_payload), 0LL); }
+    std::string Printout() const { return std::string(); }
+};
+
+template < template < typename > typename QueueType, typename PlacementType >
+double Run(long count, int producers)
+{
+    using PolicyType = AsyncWorkPolicy
+    <
+        NumaData,
+        QueueType,
+        LinuxLock,
+        ScopedLocker,
+        LinuxSynchronizer<>,
+        LinuxThreadPool < std::function < void(void) >, PlacementType >,
+        BenchThreadNumber
+    >;
+
+    std::atomic < long long > checksum(0);
+    CompletionCounter done;
+    PolicyType policy([&](const typename PolicyType::DataPtrType& d)
+    {
+        checksum.fetch_add(d->Sum(), std::memory_order_relaxed);
+        done.Add();
+    });
+
+    std::vector < std::vector < int > > nodes = CpuTopology::Instance().Place(NodePlacement::Get(), producers);
+
+    Stopwatch sw;
+    std::vector < std::thread > threads;
+    for (int p = 0; p < producers; ++p)
+    {
+        threads.emplace_back([&, p]()
+        {
+            for (long i = p; i < count; i += producers)
+                policy.Emplace(static_cast < int >(i), static_cast < int >(i % 1000));
+        });
+
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : nodes[static_cast < size_t >(p)])
+            CPU_SET(cpu, &set);
+        pthread_setaffinity_np(threads.back().native_handle(), sizeof(set), &set);
+    }
+
+    std::for_each(std::begin(threads), std::end(threads), [](std::thread& th) { th.join(); });
+    done.WaitFor(count);
+
+    return sw.Seconds();
+}
+
+template < template < typename > typename QueueType, typename PlacementType >
+void Report(const char* queue, const char* placement, long count, int threads, int producers)
+{
+    double seconds = Run < QueueType, PlacementType >(count, producers);
+    std::printf("%s,%s,%d,%d,%ld,%.6f,%.0f\n", queue, placement, threads, producers, count, seconds, count / seconds);
+    std::fflush(stdout);
+}
+
+int main(int argc, char* argv[])
+{
+    long count = ArgOr(argc, argv, 1, 500000);
+    int threads = static_cast < int >(ArgOr(argc, argv, 2, std::thread::hardware_concurrency()));
+    int producers = static_cast < int >(ArgOr(argc, argv, 3, 4));
+
+    BenchThreadNumber::Count() = threads;
+
+    std::printf("# %d NUMA node(s)\n", CpuTopology::Instance().Nodes());
+    std::printf("queue,placement,threads,producers,items,seconds,items_per_sec\n");
+    Report < PriorityQueue, NoPlacement >("single_lock", "none", count, threads, producers);
+    Report < PriorityQueue, CompactPlacement >("single_lock", "compact", count, threads, producers);
+    Report < PriorityQueue, ScatterPlacement >("single_lock", "scatter", count, threads, producers);
+    Report < PriorityQueue, NodePlacement >("single_lock", "node", count, threads, producers);
+    Report < NodeLocalPriorityQueue, NodePlacement >("node_local", "node", count, threads, producers);
+
+    return 0;
+}
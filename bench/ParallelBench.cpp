@@ -0,0 +1,74 @@
+#include "Bench.h"
+#include "LinuxPolicy.h"
+
+#include <cmath>
+
+// Scaling of ParallelFor, ParallelTransform and ParallelReduce on the policy's
+// workers against the same loop on one thread, for arrays of 1K up to the given
+// size in steps of ten. Transform works in place on one float array; each size
+// is repeated until about 100M elements were processed.
+// Usage: ParallelBench [max elements] [threads]
+
+using PolicyType = AsyncWorkPolicy
+<
+    BenchData,
+    PriorityQueue,
+    LinuxLock,
+    ScopedLocker,
+    LinuxSynchronizer<>,
+    LinuxThreadPool<>,
+    BenchThreadNumber
+>;
+
+template < typename FunType >
+double Time(long repeat, FunType&& fn)
+{
+    Stopwatch watch;
+    for (long r = 0; r < repeat; ++r)
+        fn();
+    return watch.Seconds() / repeat;
+}
+
+void Report(const char* mode, size_t size, double serial, double parallel)
+{
+    std::printf("%s,%d,%zu,%.1f,%.1f,%.2f\n", mode, BenchThreadNumber::Get() + 1, size,
+        serial * 1e6, parallel * 1e6, serial / parallel);
+    std::fflush(stdout);
+}
+
+int main(int argc, char* argv[])
+{
+    size_t maxSize = static_cast < size_t >(ArgOr(argc, argv, 1, 100000000));
+    BenchThreadNumber::Count() = static_cast < int >(ArgOr(argc, argv, 2, BenchThreadNumber::Get()));
+
+    PolicyType policy([](const PolicyType::DataPtrType&) {});
+    std::vector < float > values(maxSize, 1.0f);
+
+    auto step = [](float x) { return std::sqrt(x * x + 1.0f); };
+    volatile double sink = 0;
+
+    std::printf("mode,threads,elements,serial_us,parallel_us,speedup\n");
+    for (size_t size = 1000; size <= maxSize; size *= 10)
+    {
+        long repeat = static_cast < long >(std::max < size_t >(100000000 / size, 1));
+        std::vector < float >::iterator first = std::begin(values);
+        std::vector < float >::iterator last = first + size;
+
+        double serial = Time(repeat, [&]() { for (size_t i = 0; i < size; ++i) values[i] = step(values[i]); });
+        double parallel = Time(repeat, [&]()
+        {
+            policy.ParallelFor(size_t(0), size, [&](size_t i) { values[i] = step(values[i]); });
+        });
+        Report("for", size, serial, parallel);
+
+        serial = Time(repeat, [&]() { std::transform(first, last, first, step); });
+        parallel = Time(repeat, [&]() { policy.ParallelTransform(first, last, first, step); });
+        Report("transform", size, serial, parallel);
+
+        serial = Time(repeat, [&]() { sink = sink + std::accumulate(first, last, 0.0); });
+        parallel = Time(repeat, [&]() { sink = sink + policy.ParallelReduce(first, last, 0.0, std::plus < double >()); });
+        Report("reduce", size, serial, parallel);
+    }
+
+    return 0;
+}
@@ -0,0 +1,189 @@
+#include "Bench.h"
+#include "LinuxPolicy.h"
+#include "CrtPolicy.h"
+
+#include <sys/resource.h>
+
+// Every lock, synchronizer and thread pool backend combination, swept over worker
+// count, producer count and payload size. Reports items/sec, enqueue-to-callback
+// latency percentiles and process CPU time as CSV, or as JSON when asked to.
+// Usage: PolicyBench [items] [max threads] [max producers] [csv|json]
+
+template < size_t Bytes >
+class Payload
+{
+    int m_id;
+    int m_p;
+    long long m_stamp;
+    std::array < char, Bytes > m_data;
+public:
+    Payload(int id, int p) : m_id(id), m_p(p), m_stamp(NowNs()) { m_data.fill(static_cast < char >(id)); }
+
+    int GetId() const { return m_id; }
+    int GetPriority() const { return m_p; }
+    long long GetStamp() const { return m_stamp; }
+    std::string Printout() const { return std::string(); }
+};
+
+struct Result
+{
+    const char* lock;
+    const char* sync;
+    const char* pool;
+    int threads;
+    int producers;
+    size_t payload;
+    long items;
+    double seconds;
+    double cpuSeconds;
+    long long p50;
+    long long p99;
+    long long p999;
+};
+
+class Reporter
+{
+    bool m_json;
+    bool m_first;
+public:
+    Reporter(bool json) : m_json(json), m_first(true)
+    {
+        if (m_json)
+            std::printf("[\n");
+        else
+            std::printf("lock,sync,pool,threads,producers,payload_bytes,items,seconds,items_per_sec,p50_us,p99_us,p999_us,cpu_seconds\n");
+    }
+
+    ~Reporter()
+    {
+        if (m_json) std::printf("\n]\n");
+    }
+
+    void Add(const Result& r)
+    {
+        if (m_json)
+        {
+            std::printf("%s  { \"lock\": \"%s\", \"sync\": \"%s\", \"pool\": \"%s\", \"threads\": %d, \"producers\": %d, "
+                "\"payload_bytes\": %zu, \"items\": %ld, \"seconds\": %.6f, \"items_per_sec\": %.0f, "
+                "\"p50_us\": %.3f, \"p99_us\": %.3f, \"p999_us\": %.3f, \"cpu_seconds\": %.3f }",
+                m_first ? "" : ",\n", r.lock, r.sync, r.pool, r.threads, r.producers, r.payload, r.items, r.seconds,
+                r.items / r.seconds, r.p50 / 1e3, r.p99 / 1e3, r.p999 / 1e3, r.cpuSeconds);
+        }
+        else
+        {
+            std::printf("%s,%s,%s,%d,%d,%zu,%ld,%.6f,%.0f,%.3f,%.3f,%.3f,%.3f\n", r.lock, r.sync, r.pool, r.threads,
+                r.producers, r.payload, r.items, r.seconds, r.items / r.seconds, r.p50 / 1e3, r.p99 / 1e3,
+                r.p999 / 1e3, r.cpuSeconds);
+        }
+
+        std::fflush(stdout);
+        m_first = false;
+    }
+};
+
+double CpuSeconds()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+template < typename LockType, typename SyncType, typename PoolType, size_t Bytes >
+Result Run(long count, int producers)
+{
+    using PolicyType = AsyncWorkPolicy
+    <
+        Payload < Bytes >,
+        PriorityQueue,
+        LockType,
+        ScopedLocker,
+        SyncType,
+        PoolType,
+        BenchThreadNumber
+    >;
+
+    std::vector < long long > latencies(count);
+    Result r = {};
+
+    double cpu = CpuSeconds();
+    {
+        CompletionCounter done;
+        QuietOutput quiet;
+        PolicyType policy([&](typename PolicyType::DataPtrType d)
+        {
+            latencies[d->GetId()] = NowNs() - d->GetStamp();
+            done.Add();
+        });
+
+        Stopwatch sw;
+        std::vector < std::thread > threads;
+        for (int p = 0; p < producers; ++p)
+        {
+            threads.emplace_back([&policy, count, producers, p]()
+            {
+                for (long i = p; i < count; i += producers)
+                    policy.Emplace(static_cast < int >(i), static_cast < int >(i % 1000));
+            });
+        }
+
+        std::for_each(std::begin(threads), std::end(threads), [](std::thread& th) { th.join(); });
+        done.WaitFor(count);
+        r.seconds = sw.Seconds();
+    }
+    r.cpuSeconds = CpuSeconds() - cpu;
+
+    r.threads = BenchThreadNumber::Get();
+    r.producers = producers;
+    r.payload = sizeof(Payload < Bytes >);
+    r.items = count;
+    r.p50 = Percentile(latencies, 0.5);
+    r.p99 = Percentile(latencies, 0.99);
+    r.p999 = Percentile(latencies, 0.999);
+
+    return r;
+}
+
+template < typename LockType, typename SyncType, typename PoolType, size_t Bytes >
+void Report(Reporter& reporter, const char* lock, const char* sync, const char* pool, long count, int producers)
+{
+    Result r = Run < LockType, SyncType, PoolType, Bytes >(count, producers);
+    r.lock = lock;
+    r.sync = sync;
+    r.pool = pool;
+    reporter.Add(r);
+}
+
+template < size_t Bytes >
+void Combinations(Reporter& reporter, long count, int producers)
+{
+    Report < LinuxLock, LinuxSynchronizer<>, LinuxThreadPool<>, Bytes >(reporter, "linux", "linux", "linux", count, producers);
+    Report < LinuxLock, LinuxSynchronizer<>, CrtThreadPool<>, Bytes >(reporter, "linux", "linux", "crt", count, producers);
+    Report < LinuxLock, CrtSynchronizer<>, LinuxThreadPool<>, Bytes >(reporter, "linux", "crt", "linux", count, producers);
+    Report < LinuxLock, CrtSynchronizer<>, CrtThreadPool<>, Bytes >(reporter, "linux", "crt", "crt", count, producers);
+    Report < CrtLock, LinuxSynchronizer<>, LinuxThreadPool<>, Bytes >(reporter, "crt", "linux", "linux", count, producers);
+    Report < CrtLock, LinuxSynchronizer<>, CrtThreadPool<>, Bytes >(reporter, "crt", "linux", "crt", count, producers);
+    Report < CrtLock, CrtSynchronizer<>, LinuxThreadPool<>, Bytes >(reporter, "crt", "crt", "linux", count, producers);
+    Report < CrtLock, CrtSynchronizer<>, CrtThreadPool<>, Bytes >(reporter, "crt", "crt", "crt", count, producers);
+}
+
+int main(int argc, char* argv[])
+{
+    long count = ArgOr(argc, argv, 1, 100000);
+    int maxThreads = static_cast < int >(ArgOr(argc, argv, 2, std::thread::hardware_concurrency()));
+    int maxProducers = static_cast < int >(ArgOr(argc, argv, 3, 4));
+    bool json = (argc > 4) && !std::strcmp(argv[4], "json");
+
+    Reporter reporter(json);
+    for (int threads = 1; threads <= maxThreads; threads <<= 1)
+    {
+        BenchThreadNumber::Count() = threads;
+        for (int producers = 1; producers <= maxProducers; producers <<= 1)
+        {
+            Combinations < 16 >(reporter, count, producers);
+            Combinations < 256 >(reporter, count, producers);
+            Combinations < 4096 >(reporter, count, producers);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,81 @@
+#include "Bench.h"
+#include "LinuxPolicy.h"
+
+// Heap allocations per item for shared_ptr items versus pooled handles,
+// measured in steady state after a warm-up round.
+// Usage: PoolBench [items] [threads]
+
+static std::atomic < long > g_allocations(0);
+
+void* operator new(size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+template < template < typename > typename QueueType >
+using BenchPolicy = AsyncWorkPolicy
+<
+    BenchData,
+    QueueType,
+    LinuxLock,
+    ScopedLocker,
+    LinuxSynchronizer<>,
+    LinuxThreadPool<>,
+    BenchThreadNumber
+>;
+
+template < typename PolicyType >
+void Round(PolicyType& policy, CompletionCounter& done, long& produced, long count)
+{
+    // Stay well inside the pool capacity even when producing faster than consuming.
+    const long window = static_cast < long >(ObjectPool < BenchData >::DefaultCapacity / 2);
+
+    for (long i = 0; i < count; ++i, ++produced)
+    {
+        if (i >= window) done.WaitFor(produced - window);
+        policy.Perform(policy.Make(static_cast < int >(i), static_cast < int >(i), static_cast < int >(i % 1000)));
+    }
+
+    done.WaitFor(produced);
+}
+
+template < typename PolicyType >
+void Run(const char* name, long count)
+{
+    long allocations = 0;
+    double seconds = 0;
+    {
+        QuietOutput quiet;
+        CompletionCounter done;
+        PolicyType policy([&done](const typename PolicyType::DataPtrType&) { done.Add(); });
+
+        long produced = 0;
+        Round(policy, done, produced, count);
+
+        long before = g_allocations.load();
+        Stopwatch sw;
+        Round(policy, done, produced, count);
+        seconds = sw.Seconds();
+        allocations = g_allocations.load() - before;
+    }
+
+    std::printf("%s,%d,%ld,%ld,%.4f,%.6f,%.0f\n", name, BenchThreadNumber::Get(), count, allocations,
+        static_cast < double >(allocations) / count, seconds, count / seconds);
+}
+
+int main(int argc, char* argv[])
+{
+    long count = ArgOr(argc, argv, 1, 500000);
+    BenchThreadNumber::Count() = static_cast < int >(ArgOr(argc, argv, 2, BenchThreadNumber::Get()));
+
+    std::printf("mode,threads,items,allocations,allocations_per_item,seconds,items_per_sec\n");
+    Run < BenchPolicy < PriorityQueue > >("shared_ptr", count);
+    Run < BenchPolicy < PooledPriorityQueue > >("pooled", count);
+
+    return 0;
+}
@@ -0,0 +1,77 @@
+#include "Bench.h"
+#include "LinuxPolicy.h"
+
+// Throughput against worker count for the single-lock heap and the concurrent
+// queue variants, with several producers feeding each policy.
+// Usage: ShardBench [items] [max threads] [producers]
+
+template < template < typename > typename QueueType >
+using BenchPolicy = AsyncWorkPolicy
+<
+    BenchData,
+    QueueType,
+    LinuxLock,
+    ScopedLocker,
+    LinuxSynchronizer<>,
+    LinuxThreadPool<>,
+    BenchThreadNumber
+>;
+
+template < template < typename > typename QueueType >
+double Run(long count, int producers)
+{
+    using PolicyType = BenchPolicy < QueueType >;
+
+    CompletionCounter done;
+    QuietOutput quiet;
+    PolicyType policy([&done](const typename PolicyType::DataPtrType&) { done.Add(); });
+
+    std::vector < typename PolicyType::DataPtrType > items;
+    items.reserve(count);
+    for (long i = 0; i < count; ++i)
+        items.push_back(policy.Make(static_cast < int >(i), static_cast < int >(i), static_cast < int >(i % 1000)));
+
+    Stopwatch sw;
+    std::vector < std::thread > threads;
+    for (int p = 0; p < producers; ++p)
+    {
+        threads.emplace_back([&, p]()
+        {
+            for (long i = p; i < count; i += producers)
+                policy.Perform(std::move(items[i]));
+        });
+    }
+
+    std::for_each(std::begin(threads), std::end(threads), [](std::thread& th) { th.join(); });
+    done.WaitFor(count);
+
+    return sw.Seconds();
+}
+
+template < template < typename > typename QueueType >
+void Report(const char* name, long count, int threads, int producers)
+{
+    double seconds = Run < QueueType >(count, producers);
+    std::printf("%s,%d,%d,%ld,%.6f,%.0f\n", name, threads, producers, count, seconds, count / seconds);
+}
+
+int main(int argc, char* argv[])
+{
+    long count = ArgOr(argc, argv, 1, 500000);
+    int maxThreads = static_cast < int >(ArgOr(argc, argv, 2, std::thread::hardware_concurrency()));
+    int producers = static_cast < int >(ArgOr(argc, argv, 3, 4));
+
+    std::printf("queue,threads,producers,items,seconds,items_per_sec\n");
+    for (int threads = 1; threads <= maxThreads; threads <<= 1)
+    {
+        BenchThreadNumber::Count() = threads;
+
+        Report < PriorityQueue >("single_lock", count, threads, producers);
+        Report < ConcurrentPriorityQueue >("multiqueue", count, threads, producers);
+        Report < WorkStealingQueue >("work_stealing", count, threads, producers);
+        Report < ShardedPriorityQueue >("sharded_round_robin", count, threads, producers);
+        Report < HashedShardedPriorityQueue >("sharded_hash", count, threads, producers);
+    }
+
+    return 0;
+}
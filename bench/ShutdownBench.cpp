@@ -0,0 +1,49 @@
+#include "Bench.h"
+#include "LinuxPolicy.h"
+
+// Time Shutdown takes and items it leaves per mode, with a backlog of queued
+// items whose callbacks take 100us each.
+// Usage: ShutdownBench [backlog] [deadline us]
+
+using PolicyType = AsyncWorkPolicy
+<
+    BenchData,
+    PriorityQueue,
+    LinuxLock,
+    ScopedLocker,
+    LinuxSynchronizer<>,
+    LinuxThreadPool<>,
+    BenchThreadNumber
+>;
+
+void Run(const char* mode, const ShutdownOptions& options, long backlog)
+{
+    CompletionCounter done;
+    PolicyType policy([&done](const PolicyType::DataPtrType&)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        done.Add();
+    });
+
+    for (long i = 0; i < backlog; ++i)
+        policy.Emplace(static_cast < int >(i), 0, static_cast < int >(i % 1000));
+
+    ShutdownReport < PolicyType::DataPtrType > report = policy.Shutdown(options);
+    std::printf("%s,%d,%ld,%lu,%zu,%.3f\n", mode, BenchThreadNumber::Get(), backlog, report.drained, report.Left(),
+        std::chrono::duration < double, std::milli >(report.elapsed).count());
+    std::fflush(stdout);
+}
+
+int main(int argc, char* argv[])
+{
+    long backlog = ArgOr(argc, argv, 1, 10000);
+    long deadline = ArgOr(argc, argv, 2, 20000);
+
+    std::printf("mode,threads,backlog,drained,left,shutdown_ms\n");
+    Run("abort", ShutdownOptions::Abort(), backlog);
+    Run("drain_until", ShutdownOptions::Until(std::chrono::microseconds(deadline)), backlog);
+    Run("drain_above_900", ShutdownOptions::Above(900), backlog);
+    Run("drain_all", ShutdownOptions(), backlog);
+
+    return 0;
+}
@@ -0,0 +1,64 @@
+#include "Bench.h"
+#include "LinuxPolicy.h"
+
+// Items/sec with many producers calling Perform directly versus staging their
+// items in a per-producer StagingBuffer, for 1 to 32 producers.
+// Usage: StagingBench [items] [max producers] [threads] [capacity]
+
+using BenchPolicy = AsyncWorkPolicy
+<
+    BenchData,
+    PriorityQueue,
+    LinuxLock,
+    ScopedLocker,
+    LinuxSynchronizer<>,
+    LinuxThreadPool<>,
+    BenchThreadNumber
+>;
+
+template < typename ProduceType >
+double Run(long count, int producers, ProduceType&& produce)
+{
+    CompletionCounter done;
+    QuietOutput quiet;
+    BenchPolicy policy([&done](const BenchPolicy::DataPtrType&) { done.Add(); });
+
+    Stopwatch sw;
+    std::vector < std::thread > threads;
+    for (int p = 0; p < producers; ++p)
+        threads.emplace_back([&, p]() { produce(policy, p); });
+
+    std::for_each(std::begin(threads), std::end(threads), [](std::thread& th) { th.join(); });
+    done.WaitFor(count);
+
+    return sw.Seconds();
+}
+
+int main(int argc, char* argv[])
+{
+    long count = ArgOr(argc, argv, 1, 500000);
+    int maxProducers = static_cast < int >(ArgOr(argc, argv, 2, 32));
+    BenchThreadNumber::Count() = static_cast < int >(ArgOr(argc, argv, 3, BenchThreadNumber::Get()));
+    int capacity = static_cast < int >(ArgOr(argc, argv, 4, 64));
+
+    std::printf("mode,producers,threads,capacity,items,seconds,items_per_sec\n");
+    for (int producers = 1; producers <= maxProducers; producers <<= 1)
+    {
+        double seconds = Run(count, producers, [count, producers](BenchPolicy& policy, int p)
+        {
+            for (long i = p; i < count; i += producers)
+                policy.Emplace(static_cast < int >(i), p, static_cast < int >(i % 1000));
+        });
+        std::printf("direct,%d,%d,%d,%ld,%.6f,%.0f\n", producers, BenchThreadNumber::Get(), 1, count, seconds, count / seconds);
+
+        seconds = Run(count, producers, [count, producers, capacity](BenchPolicy& policy, int p)
+        {
+            StagingBuffer < BenchPolicy > staging(policy, capacity);
+            for (long i = p; i < count; i += producers)
+                staging.Emplace(static_cast < int >(i), p, static_cast < int >(i % 1000));
+        });
+        std::printf("staged,%d,%d,%d,%ld,%.6f,%.0f\n", producers, BenchThreadNumber::Get(), capacity, count, seconds, count / seconds);
+    }
+
+    return 0;
+}
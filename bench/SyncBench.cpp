@@ -0,0 +1,85 @@
+#include "Bench.h"
+#include "LinuxPolicy.h"
+#include "CrtPolicy.h"
+
+#include <sys/resource.h>
+
+// Items/sec, voluntary context switches and (for the futex synchronizer) futex
+// calls per item, for per-item and batched submission.
+// Usage: SyncBench [items] [threads] [batch]
+
+template < typename SyncType >
+using BenchPolicy = AsyncWorkPolicy
+<
+    BenchData,
+    ValuePriorityQueue,
+    LinuxLock,
+    ScopedLocker,
+    SyncType,
+    LinuxThreadPool<>,
+    BenchThreadNumber
+>;
+
+long ContextSwitches()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_nvcsw;
+}
+
+template < typename SyncType >
+void Run(const char* name, long count, int batch)
+{
+    using PolicyType = BenchPolicy < SyncType >;
+
+    std::vector < BenchData > items;
+    items.reserve(batch);
+
+    long switches = ContextSwitches();
+    unsigned long syscalls = LinuxFutexSynchronizer::SyscallCount();
+    double seconds = 0;
+    {
+        CompletionCounter done;
+        QuietOutput quiet;
+        PolicyType policy([&done](BenchData&&) { done.Add(); });
+
+        Stopwatch sw;
+        for (long i = 0; i < count; i += batch)
+        {
+            items.clear();
+            for (long j = i; j < std::min(count, i + batch); ++j)
+                items.emplace_back(static_cast < int >(j), static_cast < int >(j), static_cast < int >(j % 1000));
+
+            if (batch == 1)
+                policy.Perform(std::move(items.front()));
+            else
+                policy.PerformBatch(std::make_move_iterator(items.begin()), std::make_move_iterator(items.end()));
+        }
+
+        done.WaitFor(count);
+        seconds = sw.Seconds();
+    }
+
+    switches = ContextSwitches() - switches;
+    syscalls = LinuxFutexSynchronizer::SyscallCount() - syscalls;
+
+    std::printf("%s,%d,%d,%ld,%.6f,%.0f,%.4f,%.4f\n", name, BenchThreadNumber::Get(), batch, count, seconds,
+        count / seconds, static_cast < double >(switches) / count, static_cast < double >(syscalls) / count);
+}
+
+int main(int argc, char* argv[])
+{
+    long count = ArgOr(argc, argv, 1, 500000);
+    BenchThreadNumber::Count() = static_cast < int >(ArgOr(argc, argv, 2, BenchThreadNumber::Get()));
+    int batch = static_cast < int >(ArgOr(argc, argv, 3, 64));
+
+    std::printf("sync,threads,batch,items,seconds,items_per_sec,ctx_switches_per_item,futex_calls_per_item\n");
+    for (int b : { 1, batch })
+    {
+        Run < LinuxSynchronizer<> >("semaphore", count, b);
+        Run < CrtSynchronizer<> >("condition_variable", count, b);
+        Run < LinuxFutexSynchronizer >("futex", count, b);
+    }
+
+    return 0;
+}
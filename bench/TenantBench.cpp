@@ -0,0 +1,114 @@
+#include "Bench.h"
+#include "LinuxPolicy.h"
+
+// One noisy tenant against two quiet ones on 2 * cores + 1 workers. The noisy
+// tenant floods the queue with high priority items blocking for 1ms, the quiet
+// ones trickle in items busy for 20us. Reports per tenant queue latency for one
+// shared PriorityQueue, equal fair sharing, and fair sharing with the noisy
+// tenant capped to half the workers.
+// Usage: TenantBench [duration ms]
+
+class TenantData
+{
+    int m_index;
+    int m_tenant;
+    int m_p;
+    long long m_enqueued;
+public:
+    TenantData(int index, int tenant, int p) : m_index(index), m_tenant(tenant), m_p(p), m_enqueued(MonotonicNs()) {}
+
+    int Index() const { return m_index; }
+    int GetTenant() const { return m_tenant; }
+    int GetPriority() const { return m_p; }
+    long long Enqueued() const { return m_enqueued; }
+    std::string Printout() const { return std::string(); }
+};
+
+struct PoolThreadNumber
+{
+    static int Get() { return (get_nprocs() << 1) + 1; }
+};
+
+struct CappedTenants
+{
+    static int Weight(int) { return 1; }
+    static int Cap(int c) { return c ? std::numeric_limits < int >::max() : std::max(PoolThreadNumber::Get() / 2, 1); }
+};
+
+template < template < typename > typename QueueType >
+void Run(const char* mode, long durationMs)
+{
+    using PolicyType = AsyncWorkPolicy
+    <
+        TenantData,
+        QueueType,
+        LinuxLock,
+        ScopedLocker,
+        LinuxSynchronizer<>,
+        LinuxThreadPool<>,
+        PoolThreadNumber
+    >;
+
+    // Noisy items alone would take 1.5 times the pool.
+    long noisyPerMs = static_cast < long >(1.5 * PoolThreadNumber::Get());
+    long quietPerMs = 10;
+    long count = (noisyPerMs + quietPerMs) * durationMs;
+
+    std::vector < long long > latency(count);
+    std::vector < int > tenant(count);
+    CompletionCounter done;
+
+    PolicyType policy([&](const typename PolicyType::DataPtrType& d)
+    {
+        long long start = MonotonicNs();
+        latency[static_cast < size_t >(d->Index())] = start - d->Enqueued();
+
+        if (d->GetTenant() == 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        else
+            while (MonotonicNs() - start < 20000) {}
+
+        done.Add();
+    });
+
+    long index = 0;
+    long long begin = MonotonicNs();
+    for (long ms = 0; ms < durationMs; ++ms)
+    {
+        while (MonotonicNs() - begin < ms * 1000000)
+            std::this_thread::yield();
+
+        for (long i = 0; i < noisyPerMs + quietPerMs; ++i, ++index)
+        {
+            tenant[index] = (i < noisyPerMs) ? 0 : 1 + static_cast < int >(i % 2);
+            policy.Perform(policy.Make(static_cast < int >(index), tenant[index], tenant[index] ? 10 : 900));
+        }
+    }
+
+    done.WaitFor(count);
+
+    for (int t = 0; t < 3; ++t)
+    {
+        std::vector < long long > samples;
+        for (long i = 0; i < count; ++i)
+            if (tenant[i] == t) samples.push_back(latency[i]);
+
+        long long p50 = Percentile(samples, 0.5);
+        long long p99 = Percentile(samples, 0.99);
+        std::printf("%s,%d,%zu,%.1f,%.1f,%.1f\n", mode, t, samples.size(), p50 / 1e3, p99 / 1e3, samples.back() / 1e3);
+    }
+
+    std::fflush(stdout);
+}
+
+int main(int argc, char* argv[])
+{
+    long duration = ArgOr(argc, argv, 1, 200);
+
+    std::printf("mode,tenant,items,p50_us,p99_us,max_us\n");
+    Run < PriorityQueue >("shared", duration);
+    Run < Tenants < 3 >::Queue >("fair", duration);
+    Run < Tenants < 3, CappedTenants >::Queue >("fair_capped", duration);
+
+    return 0;
+}
@@ -0,0 +1,168 @@
+#include "Bench.h"
+#include "LinuxPolicy.h"
+#include "TimerWheel.h"
+
+#include <random>
+#include <set>
+
+// Timer wheel cost per Add, Cancel and expiry with many pending timers, spread
+// over a minute of 1ms ticks, then how late a TimerStage hands items to the
+// policy's workers for delays of up to 200ms. Checks first that stepping the
+// wheel from one NextDue to the next expires every timer on its own tick.
+// Usage: TimerBench [timers] [staged items]
+
+class TimedData
+{
+    int m_index;
+public:
+    TimedData(int index) : m_index(index) {}
+
+    int Index() const { return m_index; }
+    int GetPriority() const { return 0; }
+    std::string Printout() const { return std::string(); }
+};
+
+using PolicyType = AsyncWorkPolicy
+<
+    TimedData,
+    PriorityQueue,
+    LinuxLock,
+    ScopedLocker,
+    LinuxSynchronizer<>,
+    LinuxThreadPool<>,
+    BenchThreadNumber
+>;
+
+void RunWheel(long count)
+{
+    std::mt19937 rng(7);
+    std::vector < long long > ticks(count);
+    for (long long& tick : ticks)
+        tick = rng() % 60000;
+
+    TimerWheel < int > wheel;
+    std::vector < TimerHandle > handles;
+    handles.reserve(count);
+
+    Stopwatch add;
+    for (long i = 0; i < count; ++i)
+        handles.push_back(wheel.Add(static_cast < int >(i), ticks[i]));
+    double addSeconds = add.Seconds();
+
+    Stopwatch cancel;
+    for (long i = 0; i < count; i += 2)
+        wheel.Cancel(handles[i]);
+    double cancelSeconds = cancel.Seconds();
+
+    std::vector < int > due;
+    due.reserve(count);
+
+    Stopwatch expire;
+    for (long long tick = 0; tick < 60000; ++tick)
+        wheel.Advance(tick, due);
+    double expireSeconds = expire.Seconds();
+
+    std::printf("wheel,%ld,%.1f,%.1f,%.1f,%zu\n", count, addSeconds * 1e9 / count,
+        cancelSeconds * 1e9 / ((count + 1) / 2), expireSeconds * 1e9 / std::max < size_t >(due.size(), 1), due.size());
+    std::fflush(stdout);
+}
+
+// Advances only to NextDue, as TimerStage does, and counts timers expiring
+// after their tick, a NextDue past the earliest pending tick, and idle steps:
+// Advance calls that neither expire nor move down any timer, i.e. spurious
+// wake-ups of the timer thread. Every fourth step adds a timer almost one
+// revolution of the second or third wheel ahead, which Link puts into the
+// current slot of that wheel.
+void CheckNextDue(long count)
+{
+    std::mt19937 rng(3);
+    TimerWheel < long > wheel;
+    std::vector < long long > ticks(count * 2);
+    std::multiset < long long > pending;
+
+    // Timers on and just past wheel wraps, and spread over two top level slots.
+    for (long i = 0; i < count; ++i)
+    {
+        long long base = (i % 4 == 0) ? 255 : (i % 4 == 1) ? 65535 : 0;
+        ticks[i] = base + rng() % ((i % 4 < 2) ? 64 : (1LL << 25));
+        wheel.Add(static_cast < long >(i), ticks[i]);
+        pending.insert(ticks[i]);
+    }
+
+    long late = 0;
+    long early = 0;
+    long idle = 0;
+    long added = count;
+    std::vector < long > due;
+    for (long step = 0; wheel.Size(); ++step)
+    {
+        if (step % 4 == 0 && added < count * 2)
+        {
+            long long ahead = (added % 2) ? (1LL << 16) : (1LL << 24);
+            ticks[added] = wheel.Now() + ahead - 1 - rng() % 64;
+            wheel.Add(static_cast < long >(added), ticks[added]);
+            pending.insert(ticks[added++]);
+        }
+
+        long long next = wheel.NextDue();
+        if (next > *pending.begin()) ++early;
+
+        due.clear();
+        if (!wheel.Advance(next, due)) ++idle;
+        for (long index : due)
+        {
+            if (next > ticks[index]) ++late;
+            pending.erase(pending.find(ticks[index]));
+        }
+    }
+
+    std::printf("nextdue,%ld,%ld,%ld,%ld\n", added, early, late, idle);
+    std::fflush(stdout);
+}
+
+void RunStage(long count)
+{
+    std::vector < long long > due(count);
+    std::vector < long long > late(count);
+    CompletionCounter done;
+
+    PolicyType policy([&](const PolicyType::DataPtrType& d)
+    {
+        late[d->Index()] = MonotonicNs() - due[d->Index()];
+        done.Add();
+    });
+    TimerStage < PolicyType > timers(policy);
+
+    std::mt19937 rng(11);
+    for (long i = 0; i < count; ++i)
+    {
+        std::chrono::microseconds delay(rng() % 200000);
+        due[i] = MonotonicNs() + std::chrono::duration_cast < std::chrono::nanoseconds >(delay).count();
+        timers.PerformAfter(policy.Make(static_cast < int >(i)), delay);
+    }
+
+    done.WaitFor(count);
+
+    long long early = std::count_if(std::begin(late), std::end(late), [](long long ns) { return ns < 0; });
+    long long p50 = Percentile(late, 0.5);
+    long long p99 = Percentile(late, 0.99);
+    std::printf("stage,%ld,%.1f,%.1f,%.1f,%lld\n", count, p50 / 1e3, p99 / 1e3, late.back() / 1e3, early);
+    std::fflush(stdout);
+}
+
+int main(int argc, char* argv[])
+{
+    long timers = ArgOr(argc, argv, 1, 1000000);
+    long staged = ArgOr(argc, argv, 2, 10000);
+
+    std::printf("nextdue,timers,past_earliest,late,idle\n");
+    CheckNextDue(100000);
+
+    std::printf("wheel,timers,add_ns,cancel_ns,expire_ns,expired\n");
+    RunWheel(timers);
+
+    std::printf("stage,items,late_p50_us,late_p99_us,late_max_us,early\n");
+    RunStage(staged);
+
+    return 0;
+}
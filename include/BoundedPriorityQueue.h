@@ -0,0 +1,204 @@
+#if !defined( __BOUNDED_PRIORITY_QUEUE_H__ )
+#define __BOUNDED_PRIORITY_QUEUE_H__
+
+#include "Policy.h"
+#include "ObjectPool.h"
+
+// Min-max heap over storage reserved up front: the highest priority item is
+// dequeued and the lowest one evicted, both in O(log n), and a warmed-up queue
+// never allocates. Even levels order towards the minimum, odd ones towards the
+// maximum, so the minimum is the root and the maximum one of its children.
+template < typename DataType, typename ItemType, size_t QueueCapacity, Overflow Mode >
+class BasicBoundedPriorityQueue
+{
+public:
+    using DataPtrType = ItemType;
+    using ResultType = std::conditional_t
+    <
+        IsItemHandle < ItemType >::value,
+        ItemType,
+        std::optional < ItemType >
+    >;
+
+    static constexpr size_t Capacity = QueueCapacity;
+    static constexpr Overflow OverflowMode = Mode;
+
+    BasicBoundedPriorityQueue()
+    {
+        m_q.reserve(Capacity);
+    }
+
+    void Enqueue(const DataPtrType& d)
+    {
+        assert(!Full());
+        m_q.push_back(d);
+        BubbleUp(m_q.size() - 1);
+    }
+
+    void Enqueue(DataPtrType&& d)
+    {
+        assert(!Full());
+        m_q.push_back(std::move(d));
+        BubbleUp(m_q.size() - 1);
+    }
+
+    template < typename ... Args >
+    void Emplace(Args&& ... args)
+    {
+        assert(!Full());
+        m_q.emplace_back(std::forward < Args >(args) ...);
+        BubbleUp(m_q.size() - 1);
+    }
+
+    ResultType Dequeue()
+    {
+        if (m_q.empty()) return ResultType();
+        return Remove(MaxIndex());
+    }
+
+    bool Full() const
+    {
+        return m_q.size() >= Capacity;
+    }
+
+    size_t Size() const
+    {
+        return m_q.size();
+    }
+
+    int LowestPriority() const
+    {
+        assert(!m_q.empty());
+        return Priority(0);
+    }
+
+    void DropLowest()
+    {
+        if (!m_q.empty()) Remove(0);
+    }
+
+private:
+    int Priority(size_t i) const
+    {
+        return ItemRef(m_q[i]).GetPriority();
+    }
+
+    static bool MinLevel(size_t i)
+    {
+        return !(HighestSetBit(i + 1) & 1);
+    }
+
+    size_t MaxIndex() const
+    {
+        if (m_q.size() < 3) return m_q.size() - 1;
+        return (Priority(1) >= Priority(2)) ? 1 : 2;
+    }
+
+    ResultType Remove(size_t i)
+    {
+        ResultType d(std::move(m_q[i]));
+        if (i != m_q.size() - 1) m_q[i] = std::move(m_q.back());
+        m_q.pop_back();
+
+        if (i < m_q.size()) TrickleDown(i);
+        return d;
+    }
+
+    void BubbleUp(size_t i)
+    {
+        if (!i) return;
+
+        size_t parent = (i - 1) / 2;
+        if (MinLevel(i))
+        {
+            if (Priority(i) > Priority(parent))
+            {
+                std::swap(m_q[i], m_q[parent]);
+                BubbleUpTowards < std::greater < int > >(parent);
+            }
+            else
+                BubbleUpTowards < std::less < int > >(i);
+        }
+        else
+        {
+            if (Priority(i) < Priority(parent))
+            {
+                std::swap(m_q[i], m_q[parent]);
+                BubbleUpTowards < std::less < int > >(parent);
+            }
+            else
+                BubbleUpTowards < std::greater < int > >(i);
+        }
+    }
+
+    // Climbs grandparents while the item beats them; std::less on min levels.
+    template < typename BeatsType >
+    void BubbleUpTowards(size_t i)
+    {
+        while (i > 2)
+        {
+            size_t grandparent = ((i - 1) / 2 - 1) / 2;
+            if (!BeatsType()(Priority(i), Priority(grandparent))) break;
+
+            std::swap(m_q[i], m_q[grandparent]);
+            i = grandparent;
+        }
+    }
+
+    void TrickleDown(size_t i)
+    {
+        if (MinLevel(i))
+            TrickleDownTowards < std::less < int > >(i);
+        else
+            TrickleDownTowards < std::greater < int > >(i);
+    }
+
+    template < typename BeatsType >
+    void TrickleDownTowards(size_t i)
+    {
+        BeatsType beats;
+        for (;;)
+        {
+            size_t first = 2 * i + 1;
+            if (first >= m_q.size()) return;
+
+            // Best among the children and grandchildren.
+            size_t best = first;
+            for (size_t c : { first, first + 1, 2 * first + 1, 2 * first + 2, 2 * first + 3, 2 * first + 4 })
+            {
+                if (c < m_q.size() && beats(Priority(c), Priority(best)))
+                    best = c;
+            }
+
+            if (!beats(Priority(best), Priority(i))) return;
+            std::swap(m_q[best], m_q[i]);
+
+            if (best <= first + 1) return;
+
+            size_t parent = (best - 1) / 2;
+            if (beats(Priority(parent), Priority(best)))
+                std::swap(m_q[best], m_q[parent]);
+
+            i = best;
+        }
+    }
+
+    std::vector < DataPtrType > m_q;
+};
+
+// Bounded< Capacity, Mode >::Queue plugs into AsyncWorkPolicy like PriorityQueue;
+// ValueQueue and PooledQueue keep the steady state free of allocations.
+template < size_t Capacity, Overflow Mode = Overflow::Block >
+struct Bounded
+{
+    template < typename DataType >
+    using Queue = BasicBoundedPriorityQueue < DataType, std::shared_ptr < DataType >, Capacity, Mode >;
+
+    template < typename DataType >
+    using ValueQueue = BasicBoundedPriorityQueue < DataType, DataType, Capacity, Mode >;
+
+    template < typename DataType >
+    using PooledQueue = BasicBoundedPriorityQueue < DataType, PoolPtr < DataType >, Capacity, Mode >;
+};
+
+#endif // __BOUNDED_PRIORITY_QUEUE_H__
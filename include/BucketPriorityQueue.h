@@ -0,0 +1,166 @@
+#if !defined( __BUCKET_PRIORITY_QUEUE_H__ )
+#define __BUCKET_PRIORITY_QUEUE_H__
+
+#include "Policy.h"
+
+// Occupancy bitmap over a fixed number of levels, 64-ary so that finding the
+// highest set bit takes one bit scan per layer: 3 scans for 65536 levels.
+class LevelBitmap
+{
+public:
+    LevelBitmap(size_t levels)
+    {
+        size_t bits = std::max < size_t >(levels, 1);
+        do
+        {
+            bits = (bits + 63) / 64;
+            m_layers.emplace_back(bits, 0ULL);
+        }
+        while (bits > 1);
+    }
+
+    void Set(size_t level)
+    {
+        for (std::vector < unsigned long long >& layer : m_layers)
+        {
+            unsigned long long& word = layer[level / 64];
+            bool wasEmpty = !word;
+            word |= 1ULL << (level % 64);
+
+            if (!wasEmpty) return;
+            level /= 64;
+        }
+    }
+
+    void Clear(size_t level)
+    {
+        for (std::vector < unsigned long long >& layer : m_layers)
+        {
+            unsigned long long& word = layer[level / 64];
+            word &= ~(1ULL << (level % 64));
+
+            if (word) return;
+            level /= 64;
+        }
+    }
+
+    bool Empty() const
+    {
+        return !m_layers.back().front();
+    }
+
+    size_t Highest() const
+    {
+        assert(!Empty());
+
+        size_t level = 0;
+        for (size_t i = m_layers.size(); i-- > 0;)
+            level = level * 64 + static_cast < size_t >(HighestSetBit(m_layers[i][level]));
+
+        return level;
+    }
+
+private:
+    std::vector < std::vector < unsigned long long > > m_layers;
+};
+
+// One FIFO per priority level plus an occupancy bitmap: O(1) Enqueue and Dequeue,
+// first in first out among equal priorities. Priorities are clamped into
+// [0, Levels). A level allocates nothing until used and keeps its storage
+// once warmed up; consumed items are compacted away as the level drains.
+template < typename DataType, typename ItemType, size_t Levels >
+class BasicBucketPriorityQueue
+{
+public:
+    using DataPtrType = ItemType;
+    using ResultType = std::conditional_t
+    <
+        IsItemHandle < ItemType >::value,
+        ItemType,
+        std::optional < ItemType >
+    >;
+
+    BasicBucketPriorityQueue()
+    : m_levels(new Level[Levels])
+    , m_occupied(Levels)
+    {}
+
+    void Enqueue(const DataPtrType& d)
+    {
+        Push(LevelOf(d), d);
+    }
+
+    void Enqueue(DataPtrType&& d)
+    {
+        size_t level = LevelOf(d);
+        Push(level, std::move(d));
+    }
+
+    template < typename ... Args >
+    void Emplace(Args&& ... args)
+    {
+        Enqueue(DataPtrType(std::forward < Args >(args) ...));
+    }
+
+    ResultType Dequeue()
+    {
+        if (m_occupied.Empty()) return ResultType();
+
+        size_t index = m_occupied.Highest();
+        Level& level = m_levels[index];
+
+        ResultType d(std::move(level.items[level.head++]));
+        if (level.head == level.items.size())
+        {
+            level.items.clear();
+            level.head = 0;
+            m_occupied.Clear(index);
+        }
+        else if (level.head >= CompactAfter && level.head * 2 >= level.items.size())
+        {
+            level.items.erase(std::begin(level.items), std::begin(level.items) + level.head);
+            level.head = 0;
+        }
+
+        return d;
+    }
+
+private:
+    static constexpr size_t CompactAfter = 64;
+
+    struct Level
+    {
+        std::vector < DataPtrType > items;
+        size_t head = 0;
+    };
+
+    static size_t LevelOf(const DataPtrType& d)
+    {
+        int priority = ItemRef(d).GetPriority();
+        return static_cast < size_t >(std::min(std::max(priority, 0), static_cast < int >(Levels) - 1));
+    }
+
+    template < typename ItemRefType >
+    void Push(size_t index, ItemRefType&& d)
+    {
+        Level& level = m_levels[index];
+        if (level.items.size() == level.head) m_occupied.Set(index);
+        level.items.push_back(std::forward < ItemRefType >(d));
+    }
+
+    std::unique_ptr < Level[] > m_levels;
+    LevelBitmap m_occupied;
+};
+
+// Bucketed< Levels >::Queue plugs into AsyncWorkPolicy like PriorityQueue.
+template < size_t Levels >
+struct Bucketed
+{
+    template < typename DataType >
+    using Queue = BasicBucketPriorityQueue < DataType, std::shared_ptr < DataType >, Levels >;
+
+    template < typename DataType >
+    using ValueQueue = BasicBucketPriorityQueue < DataType, DataType, Levels >;
+};
+
+#endif // __BUCKET_PRIORITY_QUEUE_H__
@@ -5,17 +5,31 @@
 
 #include <sys/sysinfo.h>
 #include <pthread.h>
+#include <sched.h>
 #include <semaphore.h>
 #include <signal.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/timerfd.h>
+#include <linux/futex.h>
 
 #elif defined ( _WIN64 )
 
 #include <windows.h>
 #include <tchar.h>
 #include <process.h>
+#include <intrin.h>
+#include <io.h>
 
 #endif // __linux__
 
+#if defined( __x86_64__ ) || defined( __i386__ ) || defined( _M_X64 )
+#include <immintrin.h>
+#endif
+
 #include <string>
 #include <iostream>
 #include <thread>
@@ -24,16 +38,26 @@
 #include <exception>
 #include <stdexcept>
 #include <queue>
+#include <vector>
+#include <atomic>
+#include <limits>
+#include <type_traits>
 #include <list>
 #include <array>
 #include <memory>
+#include <optional>
+#include <tuple>
 #include <algorithm>
+#include <numeric>
 #include <functional>
 #include <sstream>
+#include <fstream>
+#include <chrono>
 #include <cstdio>
 #include <cstdlib>
 #include <ctime>
 #include <cstring>
+#include <climits>
 #include <cassert>
 
 #endif // __COMMON_H__
\ No newline at end of file
@@ -0,0 +1,477 @@
+#if !defined( __COMPLETION_H__ )
+#define __COMPLETION_H__
+
+#include "Common.h"
+
+template < typename ResultType > class CompletionPool;
+template < typename ResultType > class Completion;
+
+enum class CompletionState
+{
+    Pending,
+    Done,
+    Failed,         // The callback threw; Get() rethrows.
+    Abandoned       // The item was destroyed unprocessed: dropped, refused or never handed back.
+};
+
+// Result of one submitted item, shared by its Completion handle and the item until
+// both let go of it. The low bits of m_state hold the CompletionState, the flag
+// bits say a continuation is installed, whichever of Then and the completing side
+// comes second runs it, and that a handle sleeps on the slot and needs a wake.
+template < typename ResultType >
+class CompletionSlot
+{
+    friend class CompletionPool < ResultType >;
+
+    static constexpr unsigned int StateMask = 3u;
+    static constexpr unsigned int ContinuationBit = 4u;
+    static constexpr unsigned int WaiterBit = 8u;
+
+    using StoredType = std::conditional_t < std::is_void < ResultType >::value, bool, ResultType >;
+
+    std::atomic < unsigned int > m_state;
+    std::atomic < int > m_refs;
+    std::optional < StoredType > m_value;
+    std::exception_ptr m_error;
+    std::function < void (Completion < ResultType >&&) > m_continuation;
+    CompletionPool < ResultType >* m_pool;
+    std::atomic < unsigned int > m_next;
+
+public:
+    CompletionState State() const
+    {
+        return static_cast < CompletionState >(m_state.load() & StateMask);
+    }
+
+    template < typename ... Args >
+    void Complete(Args&& ... args)
+    {
+        m_value.emplace(std::forward < Args >(args) ...);
+        Finish(CompletionState::Done);
+    }
+
+    void Fail(std::exception_ptr error)
+    {
+        m_error = error;
+        Finish(CompletionState::Failed);
+    }
+
+    void Abandon()
+    {
+        Finish(CompletionState::Abandoned);
+    }
+
+private:
+    friend class Completion < ResultType >;
+
+    void Reset(CompletionPool < ResultType >* pool)
+    {
+        m_pool = pool;
+        m_state.store(0, std::memory_order_relaxed);
+        m_refs.store(2, std::memory_order_relaxed);
+    }
+
+    void AddRef()
+    {
+        m_refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void Release()
+    {
+        if (m_refs.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+
+        m_value.reset();
+        m_error = nullptr;
+        m_continuation = nullptr;
+        m_pool->Release(this);
+    }
+
+    // Called once by the item's side, which then drops its reference.
+    void Finish(CompletionState state)
+    {
+        unsigned int previous = m_state.fetch_or(static_cast < unsigned int >(state));
+        if (previous & WaiterBit) Unpark();
+        m_pool->Notify();
+
+        if (previous & ContinuationBit) RunContinuation();
+        Release();
+    }
+
+    template < typename FunType >
+    void SetContinuation(FunType&& fn)
+    {
+        assert(!m_continuation);
+        m_continuation = std::forward < FunType >(fn);
+
+        unsigned int previous = m_state.fetch_or(ContinuationBit);
+        if (previous & StateMask) RunContinuation();
+    }
+
+    void RunContinuation()
+    {
+        AddRef();
+        m_continuation(Completion < ResultType >(this));
+    }
+
+    bool Ready() const
+    {
+        return (m_state.load() & StateMask) != 0;
+    }
+
+#if defined ( __linux__ )
+
+    // Sleeps on m_state itself, so a completion wakes only the handle it belongs
+    // to. The waiter bit goes in before the last look at the state, and Finish
+    // reads it back from the same read-modify-write that publishes the state.
+    bool WaitUntil(std::chrono::steady_clock::time_point deadline)
+    {
+        static_assert(sizeof(m_state) == sizeof(int), "futex word must be a plain int");
+
+        for (int spin = 0; spin < 64; ++spin)
+        {
+            if (Ready()) return true;
+            std::this_thread::yield();
+        }
+
+        for (;;)
+        {
+            unsigned int state = m_state.fetch_or(WaiterBit) | WaiterBit;
+            if (state & StateMask) return true;
+
+            timespec timeout;
+            const timespec* wait = nullptr;
+            if (deadline != std::chrono::steady_clock::time_point::max())
+            {
+                long long ns = std::chrono::duration_cast < std::chrono::nanoseconds >(
+                    deadline - std::chrono::steady_clock::now()).count();
+                if (ns <= 0) return false;
+
+                timeout.tv_sec = static_cast < time_t >(ns / 1000000000);
+                timeout.tv_nsec = static_cast < long >(ns % 1000000000);
+                wait = &timeout;
+            }
+
+            syscall(SYS_futex, reinterpret_cast < int* >(&m_state), FUTEX_WAIT_PRIVATE,
+                static_cast < int >(state), wait, nullptr, 0);
+        }
+    }
+
+    void Unpark()
+    {
+        syscall(SYS_futex, reinterpret_cast < int* >(&m_state), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+    }
+
+#else
+
+    // No per-address wait here: fall back to the pool's condition variable.
+    bool WaitUntil(std::chrono::steady_clock::time_point deadline)
+    {
+        return m_pool->WaitUntil([this]() { return Ready(); }, deadline);
+    }
+
+    void Unpark() {}
+
+#endif // __linux__
+};
+
+// Fixed set of completion slots with a lock-free free list, as in ObjectPool. A single
+// handle waits on its own slot; WaitAny waiters share one condition variable, which
+// completions only touch while somebody waits there.
+template < typename ResultType >
+class CompletionPool
+{
+    static constexpr unsigned long long IndexMask = 0xffffffffull;
+
+    size_t m_capacity;
+    std::unique_ptr < CompletionSlot < ResultType >[] > m_slots;
+    alignas(64) std::atomic < unsigned long long > m_head;
+    alignas(64) std::atomic < int > m_waiters;
+    std::mutex m_lock;
+    std::condition_variable m_done;
+
+public:
+    static constexpr size_t DefaultCapacity = 1 << 12;
+
+    CompletionPool(size_t capacity = DefaultCapacity)
+    : m_capacity(capacity)
+    , m_slots(new CompletionSlot < ResultType >[capacity])
+    , m_head(capacity ? 1 : 0)
+    , m_waiters(0)
+    {
+        for (size_t i = 0; i < m_capacity; ++i)
+            m_slots[i].m_next.store(static_cast < unsigned int >((i + 1 < m_capacity) ? i + 2 : 0), std::memory_order_relaxed);
+    }
+
+    CompletionPool(const CompletionPool&) = delete;
+    CompletionPool& operator= (const CompletionPool&) = delete;
+
+    // Null when every slot is in use.
+    CompletionSlot < ResultType >* Acquire()
+    {
+        unsigned long long head = m_head.load(std::memory_order_acquire);
+        for (;;)
+        {
+            unsigned long long index = head & IndexMask;
+            if (!index) return nullptr;
+
+            unsigned long long next = m_slots[index - 1].m_next.load(std::memory_order_relaxed);
+            unsigned long long desired = ((head & ~IndexMask) + (IndexMask + 1)) | next;
+            if (m_head.compare_exchange_weak(head, desired, std::memory_order_acquire))
+            {
+                m_slots[index - 1].Reset(this);
+                return &m_slots[index - 1];
+            }
+        }
+    }
+
+    void Release(CompletionSlot < ResultType >* slot)
+    {
+        unsigned long long index = static_cast < unsigned long long >(slot - m_slots.get()) + 1;
+        unsigned long long head = m_head.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            slot->m_next.store(static_cast < unsigned int >(head & IndexMask), std::memory_order_relaxed);
+            unsigned long long desired = ((head & ~IndexMask) + (IndexMask + 1)) | index;
+            if (m_head.compare_exchange_weak(head, desired, std::memory_order_release))
+                return;
+        }
+    }
+
+    // The state is published before the waiter count is read, and waiters count
+    // themselves before checking the state, so one of the two sides sees the other.
+    void Notify()
+    {
+        if (!m_waiters.load()) return;
+
+        std::unique_lock < std::mutex > lk(m_lock);
+        m_done.notify_all();
+    }
+
+    template < typename PredicateType >
+    bool WaitUntil(PredicateType ready, std::chrono::steady_clock::time_point deadline)
+    {
+        for (int spin = 0; spin < 64; ++spin)
+        {
+            if (ready()) return true;
+            std::this_thread::yield();
+        }
+
+        std::unique_lock < std::mutex > lk(m_lock);
+        m_waiters.fetch_add(1);
+        bool done = m_done.wait_until(lk, deadline, ready);
+        m_waiters.fetch_sub(1);
+
+        return done;
+    }
+};
+
+// Move-only handle to the result of AsyncWorkPolicy::Submit. An invalid handle
+// means the item was refused or no completion slot was free.
+template < typename ResultType >
+class Completion
+{
+    CompletionSlot < ResultType >* m_slot;
+public:
+    Completion() : m_slot(nullptr) {}
+    explicit Completion(CompletionSlot < ResultType >* slot) : m_slot(slot) {}
+
+    Completion(Completion&& other) noexcept : m_slot(other.m_slot)
+    {
+        other.m_slot = nullptr;
+    }
+
+    Completion& operator= (Completion&& other) noexcept
+    {
+        if (this != &other)
+        {
+            if (m_slot) m_slot->Release();
+            m_slot = other.m_slot;
+            other.m_slot = nullptr;
+        }
+
+        return *this;
+    }
+
+    Completion(const Completion&) = delete;
+    Completion& operator= (const Completion&) = delete;
+
+    ~Completion()
+    {
+        if (m_slot) m_slot->Release();
+    }
+
+    bool Valid() const
+    {
+        return m_slot != nullptr;
+    }
+
+    CompletionState State() const
+    {
+        return m_slot ? m_slot->State() : CompletionState::Abandoned;
+    }
+
+    bool Ready() const
+    {
+        return State() != CompletionState::Pending;
+    }
+
+    void Wait() const
+    {
+        WaitUntil(std::chrono::steady_clock::time_point::max());
+    }
+
+    template < typename Rep, typename Period >
+    bool WaitFor(std::chrono::duration < Rep, Period > timeout) const
+    {
+        return WaitUntil(std::chrono::steady_clock::now() + timeout);
+    }
+
+    bool WaitUntil(std::chrono::steady_clock::time_point deadline) const
+    {
+        return !m_slot || m_slot->WaitUntil(deadline);
+    }
+
+    // Blocks on the slot pool of this handle until ready() holds; completions of
+    // other handles from the same policy wake it as well.
+    template < typename PredicateType >
+    bool Await(PredicateType ready, std::chrono::steady_clock::time_point deadline) const
+    {
+        if (ready() || !m_slot) return ready();
+        return m_slot->m_pool->WaitUntil(ready, deadline);
+    }
+
+    // Waits, then returns the result or rethrows what the callback threw.
+    decltype(auto) Get() const
+    {
+        Wait();
+        switch (State())
+        {
+        case CompletionState::Failed:
+            std::rethrow_exception(m_slot->m_error);
+        case CompletionState::Abandoned:
+            throw std::runtime_error("completion abandoned");
+        default:
+            break;
+        }
+
+        if constexpr (!std::is_void < ResultType >::value)
+            return static_cast < const ResultType& >(*m_slot->m_value);
+    }
+
+    // Runs fn with its own handle once the result is in: on the completing worker,
+    // or right here when that already happened. One continuation per handle.
+    template < typename FunType >
+    void Then(FunType&& fn)
+    {
+        assert(m_slot);
+        m_slot->SetContinuation(std::forward < FunType >(fn));
+    }
+};
+
+template < typename IteratorType >
+void WaitAll(IteratorType first, IteratorType last)
+{
+    for (; first != last; ++first)
+        first->Wait();
+}
+
+// Returns the first ready handle, or last when the range is empty or the timeout
+// passed. The handles are expected to come from the same policy.
+template < typename IteratorType >
+IteratorType WaitAny(IteratorType first, IteratorType last,
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max())
+{
+    IteratorType ready = last;
+    auto scan = [&]()
+    {
+        ready = std::find_if(first, last, [](const auto& c) { return c.Ready(); });
+        return ready != last;
+    };
+
+    if (first != last) first->Await(scan, deadline);
+    return ready;
+}
+
+// Item wrapper carrying the completion slot of a submitted item; use
+// Completable< Data, ResultType > as the policy's DataType. Copies start without
+// a slot, and an item destroyed while still holding one abandons it.
+template < typename DataType, typename ResultType = void >
+class Completable : public DataType
+{
+    CompletionSlot < ResultType >* m_completion;
+public:
+    using CompletionResultType = ResultType;
+
+    template < typename ... Args >
+    Completable(Args&& ... args)
+    : DataType(std::forward < Args >(args) ...)
+    , m_completion(nullptr)
+    {}
+
+    Completable(const Completable& other)
+    : DataType(other)
+    , m_completion(nullptr)
+    {}
+
+    // noexcept keeps containers from copying, and so abandoning, items as they grow.
+    Completable(Completable&& other) noexcept(std::is_nothrow_move_constructible < DataType >::value)
+    : DataType(std::move(other))
+    , m_completion(other.m_completion)
+    {
+        other.m_completion = nullptr;
+    }
+
+    Completable& operator= (const Completable& other)
+    {
+        DataType::operator=(other);
+        return *this;
+    }
+
+    Completable& operator= (Completable&& other) noexcept(std::is_nothrow_move_assignable < DataType >::value)
+    {
+        if (this != &other)
+        {
+            DataType::operator=(std::move(other));
+            if (m_completion) m_completion->Abandon();
+            m_completion = other.m_completion;
+            other.m_completion = nullptr;
+        }
+
+        return *this;
+    }
+
+    ~Completable()
+    {
+        if (m_completion) m_completion->Abandon();
+    }
+
+    void AttachCompletion(CompletionSlot < ResultType >* slot)
+    {
+        m_completion = slot;
+    }
+
+    CompletionSlot < ResultType >* DetachCompletion()
+    {
+        CompletionSlot < ResultType >* slot = m_completion;
+        m_completion = nullptr;
+        return slot;
+    }
+};
+
+struct NoCompletionPool {};
+
+template < typename DataType, typename = void >
+struct IsCompletable : std::false_type
+{
+    using ResultType = void;
+    using PoolType = NoCompletionPool;
+};
+
+template < typename DataType >
+struct IsCompletable < DataType, std::void_t < typename DataType::CompletionResultType > > : std::true_type
+{
+    using ResultType = typename DataType::CompletionResultType;
+    using PoolType = CompletionPool < ResultType >;
+};
+
+#endif // __COMPLETION_H__
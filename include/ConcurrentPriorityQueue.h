@@ -0,0 +1,71 @@
+#if !defined( __CONCURRENT_PRIORITY_QUEUE_H__ )
+#define __CONCURRENT_PRIORITY_QUEUE_H__
+
+#include "HeapShard.h"
+
+// Relaxed concurrent priority queue (MultiQueue): items are spread over several
+// heaps, each guarded by its own spin lock. Dequeue samples two heaps and pops
+// the better top, so the result is close to, but not strictly, the global maximum.
+template < typename DataType > class ConcurrentPriorityQueue
+{
+public:
+    using DataPtrType = std::shared_ptr < DataType >;
+
+    static constexpr bool SelfSynchronized = true;
+
+    ConcurrentPriorityQueue(int threadNum = static_cast < int >(std::thread::hardware_concurrency()))
+    : m_count(std::max(threadNum, 1) << 1)
+    , m_shards(new Shard[m_count])
+    , m_size(0)
+    {}
+
+    void Enqueue(const DataPtrType& d)
+    {
+        Push(DataPtrType(d));
+    }
+
+    void Enqueue(DataPtrType&& d)
+    {
+        Push(std::move(d));
+    }
+
+    DataPtrType Dequeue()
+    {
+        if (!ReserveItem(m_size)) return DataPtrType();
+
+        // Locked shards are skipped for the first m_count attempts.
+        DataPtrType d;
+        for (unsigned int attempt = 0;; ++attempt)
+        {
+            Shard& shard = (attempt < m_count) ? PickBetter() : m_shards[attempt % m_count];
+            if (shard.Pop(d, attempt >= m_count)) return d;
+        }
+    }
+
+private:
+    using Shard = HeapShard < DataPtrType >;
+
+    void Push(DataPtrType&& d)
+    {
+        for (unsigned int attempt = 0;; ++attempt)
+        {
+            if (m_shards[FastRandom() % m_count].Push(std::move(d), attempt >= m_count)) break;
+        }
+
+        m_size.fetch_add(1, std::memory_order_release);
+    }
+
+    Shard& PickBetter()
+    {
+        Shard& first = m_shards[FastRandom() % m_count];
+        Shard& second = m_shards[FastRandom() % m_count];
+
+        return (first.Top() >= second.Top()) ? first : second;
+    }
+
+    unsigned int m_count;
+    std::unique_ptr < Shard[] > m_shards;
+    alignas(64) std::atomic < size_t > m_size;
+};
+
+#endif // __CONCURRENT_PRIORITY_QUEUE_H__
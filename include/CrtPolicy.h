@@ -2,6 +2,18 @@
 #define  __CRT_POLICY_H__
 
 #include "Policy.h"
+#include "ConcurrentPriorityQueue.h"
+#include "WorkStealing.h"
+#include "ObjectPool.h"
+#include "ShardedPriorityQueue.h"
+#include "Instrumentation.h"
+#include "Staging.h"
+#include "BoundedPriorityQueue.h"
+#include "BucketPriorityQueue.h"
+#include "DaryPriorityQueue.h"
+#include "DeadlineQueue.h"
+#include "TenantQueue.h"
+#include "TaskGraph.h"
 
 template < bool Debug = false >
 struct CrtThreadNumber
@@ -28,36 +40,72 @@ public:
     void Unlock() { m_mtx.unlock(); }
 };
 
-class CrtSynchronizer : public GenericSync < CrtSynchronizer >
+// The token count is atomic so spinning workers can take a token without the mutex;
+// the mutex only orders sleepers against Signal.
+template < typename WaitStrategy = ParkWaitStrategy >
+class CrtSynchronizer : public GenericSync < CrtSynchronizer < WaitStrategy > >
 {
-    volatile long m_count;
-    volatile bool m_stopping;
+    std::atomic < long > m_count;
+    std::atomic < bool > m_stopping;
     std::mutex m_l;
     std::condition_variable m_s;
+    WaitStrategy m_strategy;
 
 public:
     template < typename ... Args >
-    CrtSynchronizer(Args && ...) : m_count(0), m_stopping(false) {}
+    CrtSynchronizer(Args && ... a) : m_count(0), m_stopping(false), m_strategy(std::forward < Args >(a) ...) {}
 
     void Signal()
     {
+        m_strategy.OnSignal();
         std::unique_lock < std::mutex > lk (m_l);
         ++m_count;
         m_s.notify_one();
     }
 
+    void Signal(int count)
+    {
+        m_strategy.OnSignal();
+        std::unique_lock < std::mutex > lk (m_l);
+        m_count += count;
+        for (int i = 0; i < count; ++i)
+            m_s.notify_one();
+    }
+
     bool Wait()
     {
+        if (m_strategy.Spin([this]() { return m_stopping || Take(1); }))
+            return m_stopping;
+
         std::unique_lock < std::mutex > lk(m_l);
         m_s.wait (lk,[this]()
             {
-                return (m_count > 0) || m_stopping;
+                return m_stopping || Take(1);
             });
 
-        if (m_stopping) return true;
-        --m_count;
+        return m_stopping;
+    }
 
-        return false;
+    WaitResult WaitFor(std::chrono::nanoseconds timeout)
+    {
+        bool acquired = m_strategy.Spin([this]() { return m_stopping || Take(1); });
+        if (!acquired)
+        {
+            std::unique_lock < std::mutex > lk(m_l);
+            acquired = m_s.wait_for(lk, timeout, [this]()
+                {
+                    return m_stopping || Take(1);
+                });
+        }
+
+        if (!acquired) return WaitResult::Timeout;
+        return m_stopping ? WaitResult::Stopped : WaitResult::Acquired;
+    }
+
+    int TryAcquire(int max)
+    {
+        if (m_stopping) return 0;
+        return Take(max);
     }
 
     void Stop()
@@ -66,32 +114,152 @@ public:
         m_stopping = true;
         m_s.notify_all();
     }
+
+private:
+    int Take(int max)
+    {
+        long count = m_count.load(std::memory_order_relaxed);
+        long taken = 0;
+        do
+        {
+            taken = std::min < long >(max, count);
+            if (!taken) return 0;
+        }
+        while (!m_count.compare_exchange_weak(count, count - taken, std::memory_order_acquire));
+
+        return static_cast < int >(taken);
+    }
 };
 
 template <typename ThreadFunType = std::function<void(void)>>
 class CrtThreadPool : public GenericThreadPool< CrtThreadPool< ThreadFunType > >
 {
+    struct Worker
+    {
+        int index;
+        std::thread th;
+        std::atomic < bool > finished { false };
+    };
+
     int m_thread_num;
-    std::list < std::thread > m_thl;
+    std::list < Worker > m_thl;
+    std::mutex m_thl_lock;
+    std::vector < int > m_free_indices;
     ThreadFunType m_thfn;
+    int m_next_index;
 public:
+    template < typename OtherFunType >
+    using Rebind = CrtThreadPool < OtherFunType >;
+
     CrtThreadPool(int thread_num, ThreadFunType&& thfn)
     : m_thread_num(thread_num)
     , m_thfn(thfn)
+    , m_next_index(0)
     {
-        std::cout << m_thread_num << " working threads used." << std::endl;
+        LogDebug(m_thread_num, " working threads used.");
     }
 
     ~CrtThreadPool()
     {
-        std::for_each(std::begin(m_thl), std::end(m_thl), [](std::thread& th) { th.join (); });
-        std::cout << "Threading completed." << std::endl;
+        Join();
+        LogDebug("Threading completed.");
     }
 
     void Start()
     {
         for (int i = 0; i < m_thread_num; ++i)
-            m_thl.emplace_back(m_thfn);
+            AddWorker();
+    }
+
+    // Joins outside the lock, so a worker still able to add one does not block;
+    // workers added meanwhile are joined on the next round.
+    void Join()
+    {
+        for (;;)
+        {
+            std::list < Worker > workers;
+            {
+                std::unique_lock < std::mutex > lk(m_thl_lock);
+                workers.swap(m_thl);
+            }
+
+            if (workers.empty()) return;
+            std::for_each(std::begin(workers), std::end(workers), [](Worker& w) { w.th.join (); });
+        }
+    }
+
+    // Starts one more worker; workers whose entry function returned are joined
+    // first and their indices reused, so indices stay below the peak worker count.
+    void AddWorker()
+    {
+        std::unique_lock < std::mutex > lk(m_thl_lock);
+
+        for (typename std::list < Worker >::iterator it = std::begin(m_thl); it != std::end(m_thl);)
+        {
+            if (!it->finished.load(std::memory_order_acquire))
+            {
+                ++it;
+                continue;
+            }
+
+            it->th.join();
+            if (it->index >= 0)
+                m_free_indices.push_back(it->index);
+            it = m_thl.erase(it);
+        }
+
+        int index = m_next_index;
+        if (!m_free_indices.empty())
+        {
+            std::vector < int >::iterator lowest = std::min_element(std::begin(m_free_indices), std::end(m_free_indices));
+            index = *lowest;
+            m_free_indices.erase(lowest);
+        }
+        else
+            ++m_next_index;
+
+        m_thl.emplace_back();
+        Worker& worker = m_thl.back();
+        worker.index = index;
+
+        try
+        {
+            worker.th = std::thread([this, &worker]()
+            {
+                WorkerIndex::Set(worker.index);
+                m_thfn();
+                worker.finished.store(true, std::memory_order_release);
+            });
+        }
+        catch (...)
+        {
+            m_thl.pop_back();
+            m_free_indices.push_back(index);
+            throw;
+        }
+    }
+
+    // Frees the calling worker's index when retire agrees; the worker then has to
+    // leave without touching per-worker state. Runs under the lock AddWorker
+    // hands indices out with, so the next worker reuses the index.
+    template < typename PredicateType >
+    bool RetireWorker(PredicateType retire)
+    {
+        std::unique_lock < std::mutex > lk(m_thl_lock);
+        if (!retire()) return false;
+
+        int index = WorkerIndex::Get();
+        for (Worker& w : m_thl)
+        {
+            if (w.index != index) continue;
+
+            w.index = -1;
+            break;
+        }
+
+        m_free_indices.push_back(index);
+        WorkerIndex::Set(-1);
+        return true;
     }
 
     static unsigned int GetCurrentThreadId()
@@ -108,9 +276,191 @@ using CrtThreadPoolPolicy = AsyncWorkPolicy
     PriorityQueue,
     CrtLock,
     ScopedLocker,
-    CrtSynchronizer,
+    CrtSynchronizer<>,
     CrtThreadPool<>,
     CrtThreadNumber<DEBUG_MODE>
 >;
 
+using CrtConcurrentQueuePolicy = AsyncWorkPolicy
+<
+    Data,
+    ConcurrentPriorityQueue,
+    CrtLock,
+    ScopedLocker,
+    CrtSynchronizer<>,
+    CrtThreadPool<>,
+    CrtThreadNumber<DEBUG_MODE>
+>;
+
+using CrtWorkStealingPolicy = AsyncWorkPolicy
+<
+    Data,
+    WorkStealingQueue,
+    CrtLock,
+    ScopedLocker,
+    CrtSynchronizer<>,
+    WorkStealingThreadPool<>,
+    CrtThreadNumber<DEBUG_MODE>
+>;
+
+using CrtShardedPolicy = AsyncWorkPolicy
+<
+    Data,
+    ShardedPriorityQueue,
+    CrtLock,
+    ScopedLocker,
+    CrtSynchronizer<>,
+    CrtThreadPool<>,
+    CrtThreadNumber<DEBUG_MODE>
+>;
+
+using CrtPooledPolicy = AsyncWorkPolicy
+<
+    Data,
+    PooledPriorityQueue,
+    CrtLock,
+    ScopedLocker,
+    CrtSynchronizer<>,
+    CrtThreadPool<>,
+    CrtThreadNumber<DEBUG_MODE>
+>;
+
+using CrtValuePolicy = AsyncWorkPolicy
+<
+    Data,
+    ValuePriorityQueue,
+    CrtLock,
+    ScopedLocker,
+    CrtSynchronizer<>,
+    CrtThreadPool<>,
+    CrtThreadNumber<DEBUG_MODE>
+>;
+
+using CrtAdaptiveSpinPolicy = AsyncWorkPolicy
+<
+    Data,
+    PriorityQueue,
+    CrtLock,
+    ScopedLocker,
+    CrtSynchronizer< AdaptiveSpinWaitStrategy<> >,
+    CrtThreadPool<>,
+    CrtThreadNumber<DEBUG_MODE>
+>;
+
+using CrtInstrumentedPolicy = AsyncWorkPolicy
+<
+    Stamped<Data>,
+    PriorityQueue,
+    CrtLock,
+    ScopedLocker,
+    CrtSynchronizer<>,
+    CrtThreadPool<>,
+    CrtThreadNumber<DEBUG_MODE>,
+    std::function < void (std::shared_ptr < Stamped<Data> >) >,
+    LatencyInstrumentation<>
+>;
+
+using CrtBoundedPolicy = AsyncWorkPolicy
+<
+    Data,
+    Bounded<1024, Overflow::Block>::Queue,
+    CrtLock,
+    ScopedLocker,
+    CrtSynchronizer<>,
+    CrtThreadPool<>,
+    CrtThreadNumber<DEBUG_MODE>
+>;
+
+// Demo priorities run from 1 to Maxval, at most 1000.
+using CrtBucketPolicy = AsyncWorkPolicy
+<
+    Data,
+    Bucketed<1024>::Queue,
+    CrtLock,
+    ScopedLocker,
+    CrtSynchronizer<>,
+    CrtThreadPool<>,
+    CrtThreadNumber<DEBUG_MODE>
+>;
+
+using CrtDaryHeapPolicy = AsyncWorkPolicy
+<
+    Data,
+    DaryHeap<4>::Queue,
+    CrtLock,
+    ScopedLocker,
+    CrtSynchronizer<>,
+    CrtThreadPool<>,
+    CrtThreadNumber<DEBUG_MODE>
+>;
+
+using CrtElasticPolicy = AsyncWorkPolicy
+<
+    Data,
+    PriorityQueue,
+    CrtLock,
+    ScopedLocker,
+    CrtSynchronizer<>,
+    CrtThreadPool<>,
+    ElasticThreadNumber<1, 8>
+>;
+
+using CrtCompletionPolicy = AsyncWorkPolicy
+<
+    Completable<Data>,
+    PriorityQueue,
+    CrtLock,
+    ScopedLocker,
+    CrtSynchronizer<>,
+    CrtThreadPool<>,
+    CrtThreadNumber<DEBUG_MODE>
+>;
+
+// Demo priorities run from 1 to Maxval; 1ms of waiting is worth one level.
+using CrtDeadlinePolicy = AsyncWorkPolicy
+<
+    Deadlined<Data>,
+    EarliestDeadline<>::Queue,
+    CrtLock,
+    ScopedLocker,
+    CrtSynchronizer<>,
+    CrtThreadPool<>,
+    CrtThreadNumber<DEBUG_MODE>
+>;
+
+using CrtTenantPolicy = AsyncWorkPolicy
+<
+    Tenanted<Data>,
+    Tenants<4>::Queue,
+    CrtLock,
+    ScopedLocker,
+    CrtSynchronizer<>,
+    CrtThreadPool<>,
+    CrtThreadNumber<DEBUG_MODE>
+>;
+
+using CrtGraphPolicy = AsyncWorkPolicy
+<
+    Completable<Ranked<Data>>,
+    PriorityQueue,
+    CrtLock,
+    ScopedLocker,
+    CrtSynchronizer<>,
+    CrtThreadPool<>,
+    CrtThreadNumber<DEBUG_MODE>
+>;
+
+template < typename CallbackType >
+using CrtInlinePolicy = AsyncWorkPolicy
+<
+    Data,
+    PriorityQueue,
+    CrtLock,
+    ScopedLocker,
+    CrtSynchronizer<>,
+    CrtThreadPool<>,
+    CrtThreadNumber<DEBUG_MODE>,
+    CallbackType
+>;
+
 #endif // __CRT_POLICY_H__
\ No newline at end of file
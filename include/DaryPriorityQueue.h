@@ -0,0 +1,156 @@
+#if !defined( __DARY_PRIORITY_QUEUE_H__ )
+#define __DARY_PRIORITY_QUEUE_H__
+
+#include "Policy.h"
+#include "ObjectPool.h"
+
+template < typename Type, size_t Alignment >
+struct AlignedAllocator
+{
+    using value_type = Type;
+
+    template < typename Other >
+    struct rebind { using other = AlignedAllocator < Other, Alignment >; };
+
+    AlignedAllocator() = default;
+
+    template < typename Other >
+    AlignedAllocator(const AlignedAllocator < Other, Alignment >&) {}
+
+    Type* allocate(size_t n)
+    {
+        return static_cast < Type* >(::operator new(n * sizeof(Type), std::align_val_t(Alignment)));
+    }
+
+    void deallocate(Type* p, size_t)
+    {
+        ::operator delete(p, std::align_val_t(Alignment));
+    }
+
+    template < typename Other >
+    bool operator==(const AlignedAllocator < Other, Alignment >&) const { return true; }
+
+    template < typename Other >
+    bool operator!=(const AlignedAllocator < Other, Alignment >&) const { return false; }
+};
+
+// Heap of (priority, item) pairs in one cache-line-aligned array. The priority is
+// read once, when the item is queued; sifting compares the inline keys and never
+// touches the item's payload. Arity 4 or 8 puts all children of a node next to
+// each other and makes the tree half or a third as deep as a binary heap.
+template < typename DataType, typename ItemType, size_t Arity >
+class BasicDaryPriorityQueue
+{
+    static_assert(Arity >= 2, "a heap needs at least two children per node");
+
+public:
+    using DataPtrType = ItemType;
+    using ResultType = std::conditional_t
+    <
+        IsItemHandle < ItemType >::value,
+        ItemType,
+        std::optional < ItemType >
+    >;
+
+    void Enqueue(const DataPtrType& d)
+    {
+        Push(Entry { ItemRef(d).GetPriority(), d });
+    }
+
+    void Enqueue(DataPtrType&& d)
+    {
+        int key = ItemRef(d).GetPriority();
+        Push(Entry { key, std::move(d) });
+    }
+
+    template < typename ... Args >
+    void Emplace(Args&& ... args)
+    {
+        Enqueue(DataPtrType(std::forward < Args >(args) ...));
+    }
+
+    ResultType Dequeue()
+    {
+        if (m_q.empty()) return ResultType();
+
+        ResultType d(std::move(m_q.front().item));
+        Entry last(std::move(m_q.back()));
+        m_q.pop_back();
+
+        if (!m_q.empty()) SiftDown(std::move(last));
+        return d;
+    }
+
+private:
+    struct Entry
+    {
+        int key;
+        DataPtrType item;
+    };
+
+    // Moves parents down into the hole instead of swapping, one move per level.
+    void Push(Entry&& entry)
+    {
+        size_t hole = m_q.size();
+        m_q.push_back(std::move(entry));
+        Entry moving(std::move(m_q.back()));
+
+        while (hole)
+        {
+            size_t parent = (hole - 1) / Arity;
+            if (m_q[parent].key >= moving.key) break;
+
+            m_q[hole] = std::move(m_q[parent]);
+            hole = parent;
+        }
+
+        m_q[hole] = std::move(moving);
+    }
+
+    void SiftDown(Entry&& moving)
+    {
+        size_t hole = 0;
+        size_t size = m_q.size();
+
+        for (;;)
+        {
+            size_t first = hole * Arity + 1;
+            if (first >= size) break;
+
+            size_t last = std::min(first + Arity, size);
+            size_t best = first;
+            for (size_t c = first + 1; c < last; ++c)
+            {
+                if (m_q[c].key > m_q[best].key)
+                    best = c;
+            }
+
+            if (m_q[best].key <= moving.key) break;
+
+            m_q[hole] = std::move(m_q[best]);
+            hole = best;
+        }
+
+        m_q[hole] = std::move(moving);
+    }
+
+    std::vector < Entry, AlignedAllocator < Entry, 64 > > m_q;
+};
+
+// DaryHeap< Arity >::Queue plugs into AsyncWorkPolicy like PriorityQueue; the
+// pooled variant keeps entries at 16 bytes. Child groups start at Arity * i + 1,
+// so they are contiguous but not aligned to cache lines.
+template < size_t Arity >
+struct DaryHeap
+{
+    template < typename DataType >
+    using Queue = BasicDaryPriorityQueue < DataType, std::shared_ptr < DataType >, Arity >;
+
+    template < typename DataType >
+    using ValueQueue = BasicDaryPriorityQueue < DataType, DataType, Arity >;
+
+    template < typename DataType >
+    using PooledQueue = BasicDaryPriorityQueue < DataType, PoolPtr < DataType >, Arity >;
+};
+
+#endif // __DARY_PRIORITY_QUEUE_H__
@@ -0,0 +1,264 @@
+#if !defined( __DEADLINE_QUEUE_H__ )
+#define __DEADLINE_QUEUE_H__
+
+#include "Policy.h"
+#include "ObjectPool.h"
+
+// Opt-in absolute deadline; use Deadlined< Data > as the policy's DataType. Any
+// item type with a GetDeadline() in MonotonicNs() time works the same way.
+template < typename DataType >
+class Deadlined : public DataType
+{
+    long long m_deadline;
+public:
+    static constexpr long long NoDeadline = std::numeric_limits < long long >::max();
+
+    template < typename ... Args >
+    Deadlined(Args&& ... args)
+    : DataType(std::forward < Args >(args) ...)
+    , m_deadline(NoDeadline)
+    {}
+
+    void SetDeadline(std::chrono::steady_clock::time_point when)
+    {
+        m_deadline = std::chrono::duration_cast < std::chrono::nanoseconds >(when.time_since_epoch()).count();
+    }
+
+    template < typename Rep, typename Period >
+    void SetDeadlineAfter(std::chrono::duration < Rep, Period > delay)
+    {
+        m_deadline = MonotonicNs() + std::chrono::duration_cast < std::chrono::nanoseconds >(delay).count();
+    }
+
+    long long GetDeadline() const { return m_deadline; }
+};
+
+template < typename DataType, typename = void >
+struct HasDeadline : std::false_type {};
+
+template < typename DataType >
+struct HasDeadline < DataType, std::void_t < decltype(std::declval < const DataType& >().GetDeadline()) > > : std::true_type {};
+
+// Items dispatched before or after their deadline; read while the policy runs.
+struct DeadlineStats
+{
+    unsigned long met;
+    unsigned long missed;
+    long long worstLatenessNs;
+
+    std::string Printout() const
+    {
+        std::stringstream sstm;
+        sstm << "Deadlines met: " << met << ", missed: " << missed
+             << ", worst lateness: " << worstLatenessNs / 1000 << "us." << std::endl;
+        return sstm.str();
+    }
+};
+
+// Earliest virtual deadline first. An item's virtual deadline is the earlier of
+// its own deadline, if it has one, and its enqueue time plus AgingNs for every
+// priority level it is below Ceiling. Letting an item's priority grow by one per
+// AgingNs of waiting orders items exactly the same way, so aging comes from the
+// key fixed at Enqueue and never needs the heap rebuilt: a waiting item is only
+// overtaken by items whose priority is higher by more than its wait in AgingNs.
+// With AgingNs 0 items with deadlines go first, earliest first, and the rest
+// follow by priority alone. Priorities are clamped to 0..Ceiling. Deadlines are
+// counted as met or missed when the policy dispatches an item, so items handed
+// back or put back on shutdown are not counted.
+template < typename DataType, typename ItemType, long long AgingNs, int Ceiling >
+class BasicDeadlineQueue
+{
+    static constexpr size_t Arity = 4;
+    static constexpr long long Never = std::numeric_limits < long long >::max();
+public:
+    using DataPtrType = ItemType;
+    using ResultType = std::conditional_t
+    <
+        IsItemHandle < ItemType >::value,
+        ItemType,
+        std::optional < ItemType >
+    >;
+
+    BasicDeadlineQueue()
+    : m_taken { 0, Never, 0 }
+    , m_met(0)
+    , m_missed(0)
+    , m_worst(0)
+    {}
+
+    void Enqueue(const DataPtrType& d)
+    {
+        Push(MakeEntry(DataPtrType(d)));
+    }
+
+    void Enqueue(DataPtrType&& d)
+    {
+        Push(MakeEntry(std::move(d)));
+    }
+
+    template < typename ... Args >
+    void Emplace(Args&& ... args)
+    {
+        Enqueue(DataPtrType(std::forward < Args >(args) ...));
+    }
+
+    ResultType Dequeue()
+    {
+        if (m_q.empty()) return ResultType();
+
+        m_taken = Key { m_q.front().key, m_q.front().deadline, m_q.front().priority };
+
+        ResultType d(std::move(m_q.front().item));
+        Entry last(std::move(m_q.back()));
+        m_q.pop_back();
+
+        if (!m_q.empty()) SiftDown(std::move(last));
+        return d;
+    }
+
+    // Puts back the item the last Dequeue returned under its original key, so it
+    // keeps the wait it aged by; call it under the same lock as that Dequeue.
+    void Requeue(DataPtrType&& d)
+    {
+        Push(Entry { m_taken, std::move(d) });
+    }
+
+    // Called by the policy right before the item's callback runs.
+    void Dispatched(const DataPtrType& d) const
+    {
+        if constexpr (HasDeadline < DataType >::value)
+        {
+            long long deadline = ItemRef(d).GetDeadline();
+            if (deadline != Never) Account(deadline);
+        }
+    }
+
+    DeadlineStats Deadlines() const
+    {
+        return DeadlineStats
+        {
+            m_met.load(std::memory_order_relaxed),
+            m_missed.load(std::memory_order_relaxed),
+            m_worst.load(std::memory_order_relaxed)
+        };
+    }
+
+private:
+    struct Key
+    {
+        long long key;
+        long long deadline;
+        int priority;
+    };
+
+    struct Entry : Key
+    {
+        DataPtrType item;
+
+        Entry(const Key& k, DataPtrType&& d) : Key(k), item(std::move(d)) {}
+
+        bool Before(const Entry& other) const
+        {
+            return this->key < other.key || (this->key == other.key && this->priority > other.priority);
+        }
+    };
+
+    static Entry MakeEntry(DataPtrType&& d)
+    {
+        int priority = std::min(std::max(ItemRef(d).GetPriority(), 0), Ceiling);
+
+        long long deadline = Never;
+        if constexpr (HasDeadline < DataType >::value)
+            deadline = ItemRef(d).GetDeadline();
+
+        long long key = deadline;
+        if constexpr (AgingNs > 0)
+            key = std::min(key, MonotonicNs() + static_cast < long long >(Ceiling - priority) * AgingNs);
+
+        return Entry(Key { key, deadline, priority }, std::move(d));
+    }
+
+    // Workers dispatch concurrently, so the worst lateness is raised with a CAS.
+    void Account(long long deadline) const
+    {
+        long long late = MonotonicNs() - deadline;
+        if (late <= 0)
+        {
+            m_met.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        m_missed.fetch_add(1, std::memory_order_relaxed);
+        long long worst = m_worst.load(std::memory_order_relaxed);
+        while (late > worst && !m_worst.compare_exchange_weak(worst, late, std::memory_order_relaxed)) {}
+    }
+
+    // Same hole-based sifting as BasicDaryPriorityQueue, earliest key on top.
+    void Push(Entry&& entry)
+    {
+        size_t hole = m_q.size();
+        m_q.push_back(std::move(entry));
+        Entry moving(std::move(m_q.back()));
+
+        while (hole)
+        {
+            size_t parent = (hole - 1) / Arity;
+            if (!moving.Before(m_q[parent])) break;
+
+            m_q[hole] = std::move(m_q[parent]);
+            hole = parent;
+        }
+
+        m_q[hole] = std::move(moving);
+    }
+
+    void SiftDown(Entry&& moving)
+    {
+        size_t hole = 0;
+        size_t size = m_q.size();
+
+        for (;;)
+        {
+            size_t first = hole * Arity + 1;
+            if (first >= size) break;
+
+            size_t last = std::min(first + Arity, size);
+            size_t best = first;
+            for (size_t c = first + 1; c < last; ++c)
+            {
+                if (m_q[c].Before(m_q[best]))
+                    best = c;
+            }
+
+            if (!m_q[best].Before(moving)) break;
+
+            m_q[hole] = std::move(m_q[best]);
+            hole = best;
+        }
+
+        m_q[hole] = std::move(moving);
+    }
+
+    std::vector < Entry > m_q;
+    Key m_taken;
+    mutable std::atomic < unsigned long > m_met;
+    mutable std::atomic < unsigned long > m_missed;
+    mutable std::atomic < long long > m_worst;
+};
+
+// EarliestDeadline< AgingNs, Ceiling >::Queue plugs into AsyncWorkPolicy like
+// PriorityQueue; the policy's Queue().Deadlines() reports the miss counters.
+template < long long AgingNs = 1000000, int Ceiling = 1000 >
+struct EarliestDeadline
+{
+    template < typename DataType >
+    using Queue = BasicDeadlineQueue < DataType, std::shared_ptr < DataType >, AgingNs, Ceiling >;
+
+    template < typename DataType >
+    using ValueQueue = BasicDeadlineQueue < DataType, DataType, AgingNs, Ceiling >;
+
+    template < typename DataType >
+    using PooledQueue = BasicDeadlineQueue < DataType, PoolPtr < DataType >, AgingNs, Ceiling >;
+};
+
+#endif // __DEADLINE_QUEUE_H__
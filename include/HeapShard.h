@@ -0,0 +1,93 @@
+#if !defined( __HEAP_SHARD_H__ )
+#define __HEAP_SHARD_H__
+
+#include "Policy.h"
+
+// One max-heap of a sharded queue behind its own spin lock. The top priority is
+// published for lock-free peeking, so Dequeue can compare shards before locking.
+template < typename DataPtrType >
+struct alignas(64) HeapShard
+{
+    struct Comparator
+    {
+        bool operator()(const DataPtrType& lhs, const DataPtrType& rhs) const
+        {
+            assert(lhs && rhs);
+            return (lhs->GetPriority () < rhs->GetPriority ());
+        }
+    };
+
+    SpinLock lock;
+    std::atomic < int > top { std::numeric_limits < int >::min() };
+    std::vector < DataPtrType > heap;
+
+    int Top() const
+    {
+        return top.load(std::memory_order_relaxed);
+    }
+
+    // With wait false, gives up without taking d when the lock is held.
+    bool Push(DataPtrType&& d, bool wait = true)
+    {
+        if (!Acquire(wait)) return false;
+
+        heap.push_back(std::move(d));
+        std::push_heap(std::begin(heap), std::end(heap), Comparator());
+        UpdateTop();
+        lock.Unlock();
+
+        return true;
+    }
+
+    // False when the shard was empty or, with wait false, locked.
+    bool Pop(DataPtrType& d, bool wait = true)
+    {
+        if (!Acquire(wait)) return false;
+
+        if (heap.empty())
+        {
+            lock.Unlock();
+            return false;
+        }
+
+        std::pop_heap(std::begin(heap), std::end(heap), Comparator());
+        d = std::move(heap.back());
+        heap.pop_back();
+        UpdateTop();
+        lock.Unlock();
+
+        return true;
+    }
+
+private:
+    bool Acquire(bool wait)
+    {
+        if (!wait) return lock.TryLock();
+
+        lock.Lock();
+        return true;
+    }
+
+    void UpdateTop()
+    {
+        top.store(heap.empty() ? std::numeric_limits < int >::min() : heap.front()->GetPriority(),
+            std::memory_order_relaxed);
+    }
+};
+
+// Claims one item of a sharded queue, or returns false when it holds none. The
+// count is raised only after an item sits in a shard, so every claim is backed
+// by an item and the caller's search over the shards always ends.
+inline bool ReserveItem(std::atomic < size_t >& size)
+{
+    size_t count = size.load(std::memory_order_acquire);
+    do
+    {
+        if (!count) return false;
+    }
+    while (!size.compare_exchange_weak(count, count - 1, std::memory_order_acq_rel));
+
+    return true;
+}
+
+#endif // __HEAP_SHARD_H__
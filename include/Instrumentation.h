@@ -0,0 +1,256 @@
+#if !defined( __INSTRUMENTATION_H__ )
+#define __INSTRUMENTATION_H__
+
+#include "Policy.h"
+
+// Opt-in enqueue timestamp; use Stamped< Data > as the policy's DataType to get
+// queue wait times. The stamp is taken on construction and refreshed by Stamp()
+// when an already built item is handed to the policy.
+template < typename DataType >
+class Stamped : public DataType
+{
+    mutable long long m_enqueued;
+public:
+    template < typename ... Args >
+    Stamped(Args&& ... args)
+    : DataType(std::forward < Args >(args) ...)
+    , m_enqueued(MonotonicNs())
+    {}
+
+    void SetEnqueueTime(long long ns) const { m_enqueued = ns; }
+    long long GetEnqueueTime() const { return m_enqueued; }
+};
+
+template < typename DataType, typename = void >
+struct IsStamped : std::false_type {};
+
+template < typename DataType >
+struct IsStamped < DataType, std::void_t < decltype(std::declval < const DataType& >().GetEnqueueTime()) > >
+    : std::true_type {};
+
+// Log-linear buckets in the spirit of HdrHistogram: 8 sub-buckets per power of
+// two, so any recorded value is reported within 12.5%, up to about 18 minutes.
+class HistogramLayout
+{
+public:
+    static constexpr int SubBucketBits = 3;
+    static constexpr int SubBuckets = 1 << SubBucketBits;
+    static constexpr int MaxBits = 40;
+    static constexpr int Buckets = (MaxBits - SubBucketBits + 1) * SubBuckets;
+
+    static int Index(long long ns)
+    {
+        unsigned long long value = static_cast < unsigned long long >(std::max(ns, 0LL));
+        value = std::min(value, (1ULL << MaxBits) - 1);
+        if (value < SubBuckets) return static_cast < int >(value);
+
+        int shift = HighestSetBit(value) - SubBucketBits;
+        return (shift + 1) * SubBuckets + static_cast < int >((value >> shift) - SubBuckets);
+    }
+
+    // Midpoint of the values falling into the bucket.
+    static long long Value(int index)
+    {
+        int group = index / SubBuckets;
+        long long mantissa = index % SubBuckets;
+        if (!group) return mantissa;
+
+        long long low = (SubBuckets + mantissa) << (group - 1);
+        return low + ((1LL << (group - 1)) >> 1);
+    }
+};
+
+// Written by a single thread, read by anyone; relaxed stores are all it takes.
+class LatencyHistogram
+{
+    std::array < std::atomic < unsigned long long >, HistogramLayout::Buckets > m_counts {};
+public:
+    void Record(long long ns)
+    {
+        std::atomic < unsigned long long >& count = m_counts[HistogramLayout::Index(ns)];
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    unsigned long long Get(int index) const
+    {
+        return m_counts[index].load(std::memory_order_relaxed);
+    }
+};
+
+class HistogramSnapshot
+{
+    std::vector < unsigned long long > m_counts;
+    unsigned long long m_total;
+public:
+    HistogramSnapshot() : m_counts(HistogramLayout::Buckets), m_total(0) {}
+
+    void Add(const LatencyHistogram& histogram)
+    {
+        for (int i = 0; i < HistogramLayout::Buckets; ++i)
+        {
+            unsigned long long count = histogram.Get(i);
+            m_counts[i] += count;
+            m_total += count;
+        }
+    }
+
+    unsigned long long Count() const { return m_total; }
+
+    // Nanoseconds; q in [0, 1].
+    long long Percentile(double q) const
+    {
+        if (!m_total) return 0;
+
+        unsigned long long rank = static_cast < unsigned long long >(q * (m_total - 1)) + 1;
+        unsigned long long seen = 0;
+        for (int i = 0; i < HistogramLayout::Buckets; ++i)
+        {
+            seen += m_counts[i];
+            if (seen >= rank) return HistogramLayout::Value(i);
+        }
+
+        return HistogramLayout::Value(HistogramLayout::Buckets - 1);
+    }
+};
+
+// Queue wait and callback time per priority band, processed counts per worker and
+// the queue depth high-water mark. Workers only touch their own slot, so Snapshot
+// can merge them at any time. Priorities fall into power-of-two bands:
+// <= 0, 1, 2-3, 4-7, ... and everything from 2^(PriorityBands-2) up.
+template < int PriorityBands = 8 >
+class LatencyInstrumentation
+{
+public:
+    struct Probe
+    {
+        int band;
+        long long start;
+    };
+
+    struct SnapshotType
+    {
+        std::array < HistogramSnapshot, PriorityBands > queueWait;
+        std::array < HistogramSnapshot, PriorityBands > callback;
+        std::vector < unsigned long long > processed;
+        long long depthHighWater;
+
+        unsigned long long Processed() const
+        {
+            return std::accumulate(std::begin(processed), std::end(processed), 0ULL);
+        }
+
+        std::string Printout() const
+        {
+            std::stringstream sstm;
+            sstm << "Processed: " << Processed() << ", queue depth high-water: " << depthHighWater << "." << std::endl;
+
+            for (int band = 0; band < PriorityBands; ++band)
+            {
+                if (!queueWait[band].Count() && !callback[band].Count()) continue;
+
+                sstm << "Band " << band
+                    << " - wait p50/p99/p999 ns: " << queueWait[band].Percentile(0.5)
+                    << "/" << queueWait[band].Percentile(0.99)
+                    << "/" << queueWait[band].Percentile(0.999)
+                    << ", callback p50/p99/p999 ns: " << callback[band].Percentile(0.5)
+                    << "/" << callback[band].Percentile(0.99)
+                    << "/" << callback[band].Percentile(0.999) << "." << std::endl;
+            }
+
+            return sstm.str();
+        }
+    };
+
+    LatencyInstrumentation(int threadNum)
+    : m_count(std::max(threadNum, 1))
+    , m_slots(new Slot[m_count])
+    , m_depth(0)
+    , m_high_water(0)
+    {}
+
+    template < typename ItemType >
+    void Stamp(const ItemType& item)
+    {
+        if constexpr (IsStamped < std::decay_t < decltype(ItemRef(item)) > >::value)
+            ItemRef(item).SetEnqueueTime(MonotonicNs());
+    }
+
+    void OnEnqueue(int count)
+    {
+        long long depth = m_depth.fetch_add(count, std::memory_order_relaxed) + count;
+        long long high = m_high_water.load(std::memory_order_relaxed);
+        while (depth > high && !m_high_water.compare_exchange_weak(high, depth, std::memory_order_relaxed));
+    }
+
+    template < typename ItemType >
+    void OnDequeue(const ItemType& item)
+    {
+        m_depth.fetch_sub(1, std::memory_order_relaxed);
+
+        if constexpr (IsStamped < std::decay_t < decltype(ItemRef(item)) > >::value)
+        {
+            Slot& slot = Own();
+            slot.queueWait[Band(ItemRef(item).GetPriority())].Record(MonotonicNs() - ItemRef(item).GetEnqueueTime());
+        }
+    }
+
+    template < typename ItemType >
+    Probe Begin(const ItemType& item)
+    {
+        return Probe { Band(ItemRef(item).GetPriority()), MonotonicNs() };
+    }
+
+    void End(const Probe& probe, int count = 1)
+    {
+        Slot& slot = Own();
+        slot.callback[probe.band].Record(MonotonicNs() - probe.start);
+        slot.processed.store(slot.processed.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+    }
+
+    SnapshotType Snapshot() const
+    {
+        SnapshotType snapshot;
+        snapshot.processed.reserve(m_count);
+
+        for (int i = 0; i < m_count; ++i)
+        {
+            const Slot& slot = m_slots[i];
+            for (int band = 0; band < PriorityBands; ++band)
+            {
+                snapshot.queueWait[band].Add(slot.queueWait[band]);
+                snapshot.callback[band].Add(slot.callback[band]);
+            }
+            snapshot.processed.push_back(slot.processed.load(std::memory_order_relaxed));
+        }
+
+        snapshot.depthHighWater = m_high_water.load(std::memory_order_relaxed);
+        return snapshot;
+    }
+
+    static int Band(int priority)
+    {
+        if (priority <= 0) return 0;
+        return std::min(HighestSetBit(static_cast < unsigned long long >(priority)) + 1, PriorityBands - 1);
+    }
+
+private:
+    struct alignas(64) Slot
+    {
+        std::array < LatencyHistogram, PriorityBands > queueWait;
+        std::array < LatencyHistogram, PriorityBands > callback;
+        std::atomic < unsigned long long > processed { 0 };
+    };
+
+    Slot& Own()
+    {
+        assert(WorkerIndex::Get() < m_count);
+        return m_slots[static_cast < unsigned int >(WorkerIndex::Get()) % m_count];
+    }
+
+    int m_count;
+    std::unique_ptr < Slot[] > m_slots;
+    alignas(64) std::atomic < long long > m_depth;
+    std::atomic < long long > m_high_water;
+};
+
+#endif // __INSTRUMENTATION_H__
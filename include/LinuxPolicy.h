@@ -4,24 +4,52 @@
 #ifdef __linux__
 
 #include "Policy.h"
+#include "ConcurrentPriorityQueue.h"
+#include "WorkStealing.h"
+#include "ObjectPool.h"
+#include "ShardedPriorityQueue.h"
+#include "Instrumentation.h"
+#include "Staging.h"
+#include "BoundedPriorityQueue.h"
+#include "BucketPriorityQueue.h"
+#include "DaryPriorityQueue.h"
+#include "DeadlineQueue.h"
+#include "TenantQueue.h"
+#include "TaskGraph.h"
+#include "Topology.h"
 
 using LinuxException = SystemException;
 
+// The signal handler only records the signal and writes to a pipe, both
+// async-signal-safe; WaitForStop, on the main thread, reports it and returns,
+// so stopping the policy never runs inside the handler.
 class LinuxProcessTerminationHandler final
 {
-    std::function<void (void)> m_callback;
+    static inline int s_pipe[2] = { -1, -1 };
+    static inline volatile sig_atomic_t s_signal = 0;
+    static inline volatile sig_atomic_t s_pid = 0;
+    static inline volatile sig_atomic_t s_uid = 0;
 
-    static void SignalCallback(int sig, siginfo_t* info, void* param)
+    static void SignalCallback(int sig, siginfo_t* info, void*)
     {
-        LinuxProcessTerminationHandler* handler = static_cast<LinuxProcessTerminationHandler*>(param);
-        std::cerr << "Termination callback for signal " << sig << ", process ID: " << info->si_pid << ", user ID: " << info->si_uid << "." << std::endl;
-        handler->m_callback();
+        int saved = errno;
+        s_signal = sig;
+        s_pid = info->si_pid;
+        s_uid = info->si_uid;
+
+        char byte = 0;
+        ssize_t res = write(s_pipe[1], &byte, 1);
+        static_cast < void >(res);
+        errno = saved;
     }
 
 public:
-    LinuxProcessTerminationHandler(std::function<void (void)>&& callback)
-    : m_callback(callback)
+    LinuxProcessTerminationHandler()
     {
+        if (pipe(s_pipe) < 0)
+            throw LinuxException(errno);
+        fcntl(s_pipe[1], F_SETFL, fcntl(s_pipe[1], F_GETFL) | O_NONBLOCK);
+
         struct sigaction sa;
 
         memset(&sa, 0, sizeof(sa));
@@ -47,6 +75,32 @@ public:
                 throw LinuxException(errno);
         });
     }
+
+    // Blocks until a key is pressed or a termination signal arrives; true for a signal.
+    bool WaitForStop()
+    {
+        pollfd fds[2] = { { STDIN_FILENO, POLLIN, 0 }, { s_pipe[0], POLLIN, 0 } };
+        for (;;)
+        {
+            if (poll(fds, 2, -1) < 0)
+            {
+                if (errno == EINTR) continue;
+                throw LinuxException(errno);
+            }
+
+            if (fds[1].revents & POLLIN)
+            {
+                std::cerr << "Termination callback for signal " << s_signal << ", process ID: " << s_pid << ", user ID: " << s_uid << "." << std::endl;
+                return true;
+            }
+
+            if (fds[0].revents)
+            {
+                std::cin.get();
+                return false;
+            }
+        }
+    }
 };
 
 template < bool Debug = false >
@@ -92,19 +146,22 @@ public:
     }
 };
 
-class LinuxSynchronizer : public GenericSync < LinuxSynchronizer >
+template < typename WaitStrategy = ParkWaitStrategy >
+class LinuxSynchronizer : public GenericSync < LinuxSynchronizer < WaitStrategy > >
 {
-    volatile bool m_stopping;
+    std::atomic < bool > m_stopping;
     int m_thread_num;
     sem_t m_s;
+    WaitStrategy m_strategy;
 
 public:
     template < typename ... Args >
     LinuxSynchronizer(Args&& ... a)
     : m_stopping(false)
     , m_thread_num(std::forward < int >(a ...))
+    , m_strategy(m_thread_num)
     {
-        std::cout << "Created sys V5 semaphore." << std::endl;
+        LogDebug("Created sys V5 semaphore.");
         int res = sem_init (&m_s, 0, 0);
         if (res) throw LinuxException(errno);
     }
@@ -116,57 +173,401 @@ public:
 
     void Signal()
     {
-        int res = sem_post(&m_s);
-        if (res) throw LinuxException(errno);
+        m_strategy.OnSignal();
+        Post();
+    }
+
+    // POSIX has no counted post; sem_post stays in user space while nobody sleeps.
+    void Signal(int count)
+    {
+        m_strategy.OnSignal();
+        for (int i = 0; i < count; ++i)
+            Post();
     }
 
     bool Wait()
     {
-        int res = sem_wait(&m_s);
-        if (res) throw LinuxException (errno);
-        return m_stopping;
+        if (!m_strategy.Spin([this]() { return !sem_trywait(&m_s); }))
+        {
+            int res = sem_wait(&m_s);
+            if (res) throw LinuxException (errno);
+        }
+
+        // Pass the wake-up on, a batching worker may have swallowed a stop token.
+        bool stopping = m_stopping.load();
+        if (stopping) Post();
+        return stopping;
+    }
+
+    WaitResult WaitFor(std::chrono::nanoseconds timeout)
+    {
+        if (!m_strategy.Spin([this]() { return !sem_trywait(&m_s); }))
+        {
+            // sem_timedwait only takes an absolute CLOCK_REALTIME deadline. Seconds
+            // and nanoseconds are added apart so no sum overflows; a deadline past
+            // what time_t holds is no deadline at all.
+            timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            long long count = std::max < long long >(timeout.count(), 0);
+            long long sec = count / 1000000000;
+            long ns = deadline.tv_nsec + static_cast < long >(count % 1000000000);
+            if (ns >= 1000000000)
+            {
+                ns -= 1000000000;
+                ++sec;
+            }
+
+            if (sec >= std::numeric_limits < time_t >::max() - deadline.tv_sec)
+            {
+                while (sem_wait(&m_s))
+                {
+                    if (errno != EINTR) throw LinuxException(errno);
+                }
+            }
+            else
+            {
+                deadline.tv_sec += static_cast < time_t >(sec);
+                deadline.tv_nsec = ns;
+
+                while (sem_timedwait(&m_s, &deadline))
+                {
+                    if (errno == ETIMEDOUT) return WaitResult::Timeout;
+                    if (errno != EINTR) throw LinuxException(errno);
+                }
+            }
+        }
+
+        if (m_stopping)
+        {
+            Post();
+            return WaitResult::Stopped;
+        }
+
+        return WaitResult::Acquired;
+    }
+
+    int TryAcquire(int max)
+    {
+        int count = 0;
+        while (count < max && !m_stopping && !sem_trywait(&m_s))
+            ++count;
+
+        return count;
     }
 
     void Stop()
     {
         m_stopping = true;
         for (int i = 0; i < m_thread_num; ++i)
-            Signal();
+            Post();
+    }
+
+private:
+    void Post()
+    {
+        int res = sem_post(&m_s);
+        if (res) throw LinuxException(errno);
+    }
+};
+
+// Token count and stop flag share one futex word. Signal and Wait stay in user
+// space unless somebody actually sleeps; Signal(count) and Stop wake many
+// sleepers with a single FUTEX_WAKE. A signaller claims at most one wake per
+// sleeper, so a sleeper already woken but not yet running is not woken again.
+class LinuxFutexSynchronizer : public GenericSync < LinuxFutexSynchronizer >
+{
+    static constexpr unsigned int StopBit = 0x80000000u;
+
+    // Unclaimed sleepers count in the low half of m_sleepers, wakes claimed by a
+    // signaller but not yet taken up by a returning sleeper in the high half.
+    // Wakes go to whichever sleeper the kernel picks, so any returning sleeper
+    // takes up a claimed wake before counting itself out.
+    static constexpr unsigned long long Claimed = 1ull << 32;
+    static constexpr unsigned long long Unclaimed = Claimed - 1;
+
+    alignas(64) std::atomic < unsigned int > m_state;
+    alignas(64) std::atomic < unsigned long long > m_sleepers;
+
+public:
+    template < typename ... Args >
+    LinuxFutexSynchronizer(Args&& ...)
+    : m_state(0)
+    , m_sleepers(0)
+    {
+        static_assert(sizeof(m_state) == sizeof(int), "futex word must be a plain int");
+        LogDebug("Created futex synchronizer.");
+    }
+
+    void Signal()
+    {
+        Signal(1);
+    }
+
+    void Signal(int count)
+    {
+        m_state.fetch_add(static_cast < unsigned int >(count));
+
+        unsigned long long sleepers = m_sleepers.load();
+        for (;;)
+        {
+            unsigned long long unclaimed = sleepers & Unclaimed;
+            if (!unclaimed) return;
+
+            unsigned long long wake = std::min(unclaimed, static_cast < unsigned long long >(count));
+            if (m_sleepers.compare_exchange_weak(sleepers, sleepers - wake + wake * Claimed))
+            {
+                Wake(static_cast < int >(wake));
+                return;
+            }
+        }
+    }
+
+    bool Wait()
+    {
+        for (;;)
+        {
+            unsigned int state = m_state.load(std::memory_order_acquire);
+            if (state & StopBit) return true;
+
+            if (state)
+            {
+                if (m_state.compare_exchange_weak(state, state - 1, std::memory_order_acquire))
+                    return false;
+                continue;
+            }
+
+            // The kernel re-checks the word, so a Signal racing with this sleep
+            // either sees the sleeper or makes FUTEX_WAIT return at once.
+            Sleep(nullptr);
+        }
+    }
+
+    WaitResult WaitFor(std::chrono::nanoseconds timeout)
+    {
+        long long deadline = MonotonicNs() + timeout.count();
+        for (;;)
+        {
+            unsigned int state = m_state.load(std::memory_order_acquire);
+            if (state & StopBit) return WaitResult::Stopped;
+
+            if (state)
+            {
+                if (m_state.compare_exchange_weak(state, state - 1, std::memory_order_acquire))
+                    return WaitResult::Acquired;
+                continue;
+            }
+
+            long long left = deadline - MonotonicNs();
+            if (left <= 0) return WaitResult::Timeout;
+
+            timespec relative { static_cast < time_t >(left / 1000000000), static_cast < long >(left % 1000000000) };
+            Sleep(&relative);
+        }
+    }
+
+    int TryAcquire(int max)
+    {
+        unsigned int state = m_state.load(std::memory_order_acquire);
+        for (;;)
+        {
+            if ((state & StopBit) || !state || max <= 0) return 0;
+
+            unsigned int count = std::min(state, static_cast < unsigned int >(max));
+            if (m_state.compare_exchange_weak(state, state - count, std::memory_order_acquire))
+                return static_cast < int >(count);
+        }
+    }
+
+    void Stop()
+    {
+        m_state.fetch_or(StopBit);
+        Wake(INT_MAX);
+    }
+
+    // Process-wide number of futex calls made by all instances.
+    static unsigned long SyscallCount()
+    {
+        return Syscalls().load(std::memory_order_relaxed);
+    }
+
+private:
+    static std::atomic < unsigned long >& Syscalls()
+    {
+        static std::atomic < unsigned long > s_syscalls(0);
+        return s_syscalls;
+    }
+
+    void Sleep(const timespec* timeout)
+    {
+        m_sleepers.fetch_add(1);
+        Futex(FUTEX_WAIT_PRIVATE, 0, timeout);
+
+        unsigned long long sleepers = m_sleepers.load(std::memory_order_relaxed);
+        while (!m_sleepers.compare_exchange_weak(sleepers,
+            sleepers >= Claimed ? sleepers - Claimed : sleepers - 1, std::memory_order_relaxed)) {}
+    }
+
+    void Wake(int count)
+    {
+        Futex(FUTEX_WAKE_PRIVATE, count);
+    }
+
+    void Futex(int op, int value, const timespec* timeout = nullptr)
+    {
+        Syscalls().fetch_add(1, std::memory_order_relaxed);
+        long res = syscall(SYS_futex, reinterpret_cast < int* >(&m_state), op, value, timeout, nullptr, 0);
+        if (res < 0 && errno != EAGAIN && errno != EINTR && errno != ETIMEDOUT) throw LinuxException(errno);
     }
 };
 
-template <typename ThreadFunType = std::function<void(void)> >
-class LinuxThreadPool : public GenericThreadPool< LinuxThreadPool< ThreadFunType > >
+template <typename ThreadFunType = std::function<void(void)>, typename PlacementType = NoPlacement >
+class LinuxThreadPool : public GenericThreadPool< LinuxThreadPool< ThreadFunType, PlacementType > >
 {
+    struct Worker
+    {
+        LinuxThreadPool* pool;
+        int index;
+        pthread_t id;
+        std::atomic < bool > finished { false };
+    };
+
     int m_thread_num;
-    std::list < pthread_t > m_thl;
+    std::list < Worker > m_thl;
+    std::mutex m_thl_lock;
+    std::vector < int > m_free_indices;
     ThreadFunType m_thfn;
+    int m_next_index;
 public:
+    template < typename OtherFunType >
+    using Rebind = LinuxThreadPool < OtherFunType, PlacementType >;
+
     LinuxThreadPool(int thread_num, ThreadFunType&& thfn)
     : m_thread_num(thread_num)
     , m_thfn(thfn)
+    , m_next_index(0)
     {
-        std::cout << m_thread_num << " working threads used." << std::endl;
+        LogDebug(m_thread_num, " working threads used.");
     }
 
     ~LinuxThreadPool()
     {
-        std::for_each(std::begin(m_thl), std::end(m_thl), [](pthread_t id) { pthread_join(id, nullptr); });
-        std::cout << "System based threading completed." << std::endl;
+        Join();
+        LogDebug("System based threading completed.");
     }
 
     void Start()
     {
         for (int i = 0; i < m_thread_num; ++i)
+            AddWorker();
+    }
+
+    // Joins outside the lock, so a worker still able to add one does not block;
+    // workers added meanwhile are joined on the next round.
+    void Join()
+    {
+        for (;;)
         {
-            pthread_t id;
-            int res = pthread_create(&id, nullptr, &LinuxThreadPool::LinuxTheadPoolCallback, this);
-            if (res) throw LinuxException (errno);
+            std::list < Worker > workers;
+            {
+                std::unique_lock < std::mutex > lk(m_thl_lock);
+                workers.swap(m_thl);
+            }
 
-            m_thl.push_back(id);
+            if (workers.empty()) return;
+            std::for_each(std::begin(workers), std::end(workers), [](Worker& w) { pthread_join(w.id, nullptr); });
         }
     }
 
+    // Starts one more worker; workers whose entry function returned are joined
+    // first and their indices reused, so indices stay below the peak worker count.
+    void AddWorker()
+    {
+        std::unique_lock < std::mutex > lk(m_thl_lock);
+
+        for (typename std::list < Worker >::iterator it = std::begin(m_thl); it != std::end(m_thl);)
+        {
+            if (!it->finished.load(std::memory_order_acquire))
+            {
+                ++it;
+                continue;
+            }
+
+            pthread_join(it->id, nullptr);
+            if (it->index >= 0)
+                m_free_indices.push_back(it->index);
+            it = m_thl.erase(it);
+        }
+
+        int index = m_next_index;
+        if (!m_free_indices.empty())
+        {
+            std::vector < int >::iterator lowest = std::min_element(std::begin(m_free_indices), std::end(m_free_indices));
+            index = *lowest;
+            m_free_indices.erase(lowest);
+        }
+        else
+            ++m_next_index;
+
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+
+        std::vector < std::vector < int > > placement = CpuTopology::Instance().Place(PlacementType::Get(), index + 1);
+        if (!placement.empty())
+        {
+            const std::vector < int >& cpus = placement.back();
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            std::for_each(std::begin(cpus), std::end(cpus), [&set](int cpu) { CPU_SET(cpu, &set); });
+
+            int res = pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+            if (res)
+            {
+                pthread_attr_destroy(&attr);
+                m_free_indices.push_back(index);
+                throw LinuxException (res);
+            }
+
+            LogDebug("Worker ", index, " placed on ", cpus.size(), " CPU(s) starting at ", cpus.front(), ".");
+        }
+
+        m_thl.emplace_back();
+        Worker& worker = m_thl.back();
+        worker.pool = this;
+        worker.index = index;
+
+        int res = pthread_create(&worker.id, &attr, &LinuxThreadPool::LinuxTheadPoolCallback, &worker);
+        pthread_attr_destroy(&attr);
+        if (res)
+        {
+            m_thl.pop_back();
+            m_free_indices.push_back(index);
+            throw LinuxException (res);
+        }
+    }
+
+    // Frees the calling worker's index when retire agrees; the worker then has to
+    // leave without touching per-worker state. Runs under the lock AddWorker
+    // hands indices out with, so the next worker reuses the index.
+    template < typename PredicateType >
+    bool RetireWorker(PredicateType retire)
+    {
+        std::unique_lock < std::mutex > lk(m_thl_lock);
+        if (!retire()) return false;
+
+        int index = WorkerIndex::Get();
+        for (Worker& w : m_thl)
+        {
+            if (w.index != index) continue;
+
+            w.index = -1;
+            break;
+        }
+
+        m_free_indices.push_back(index);
+        WorkerIndex::Set(-1);
+        return true;
+    }
+
     static unsigned int GetCurrentThreadId()
     {
         return static_cast<unsigned int>(pthread_self());
@@ -175,8 +576,10 @@ public:
 private:
     static void* LinuxTheadPoolCallback(void* param)
     {
-        LinuxThreadPool* self = static_cast<LinuxThreadPool*>(param);
-        self->m_thfn();
+        Worker* worker = static_cast<Worker*>(param);
+        WorkerIndex::Set(worker->index);
+        worker->pool->m_thfn();
+        worker->finished.store(true, std::memory_order_release);
         return nullptr;
     }
 };
@@ -187,11 +590,216 @@ using LinuxThreadPoolPolicy = AsyncWorkPolicy
     PriorityQueue,
     LinuxLock,
     ScopedLocker,
-    LinuxSynchronizer,
+    LinuxSynchronizer<>,
+    LinuxThreadPool<>,
+    LinuxThreadNumber<DEBUG_MODE>
+>;
+
+using LinuxConcurrentQueuePolicy = AsyncWorkPolicy
+<
+    Data,
+    ConcurrentPriorityQueue,
+    LinuxLock,
+    ScopedLocker,
+    LinuxSynchronizer<>,
+    LinuxThreadPool<>,
+    LinuxThreadNumber<DEBUG_MODE>
+>;
+
+using LinuxWorkStealingPolicy = AsyncWorkPolicy
+<
+    Data,
+    WorkStealingQueue,
+    LinuxLock,
+    ScopedLocker,
+    LinuxSynchronizer<>,
+    WorkStealingThreadPool<>,
+    LinuxThreadNumber<DEBUG_MODE>
+>;
+
+using LinuxFutexPolicy = AsyncWorkPolicy
+<
+    Data,
+    PriorityQueue,
+    LinuxLock,
+    ScopedLocker,
+    LinuxFutexSynchronizer,
+    LinuxThreadPool<>,
+    LinuxThreadNumber<DEBUG_MODE>
+>;
+
+using LinuxShardedPolicy = AsyncWorkPolicy
+<
+    Data,
+    ShardedPriorityQueue,
+    LinuxLock,
+    ScopedLocker,
+    LinuxSynchronizer<>,
+    LinuxThreadPool<>,
+    LinuxThreadNumber<DEBUG_MODE>
+>;
+
+using LinuxPooledPolicy = AsyncWorkPolicy
+<
+    Data,
+    PooledPriorityQueue,
+    LinuxLock,
+    ScopedLocker,
+    LinuxSynchronizer<>,
+    LinuxThreadPool<>,
+    LinuxThreadNumber<DEBUG_MODE>
+>;
+
+using LinuxValuePolicy = AsyncWorkPolicy
+<
+    Data,
+    ValuePriorityQueue,
+    LinuxLock,
+    ScopedLocker,
+    LinuxSynchronizer<>,
+    LinuxThreadPool<>,
+    LinuxThreadNumber<DEBUG_MODE>
+>;
+
+using LinuxAdaptiveSpinPolicy = AsyncWorkPolicy
+<
+    Data,
+    PriorityQueue,
+    LinuxLock,
+    ScopedLocker,
+    LinuxSynchronizer< AdaptiveSpinWaitStrategy<> >,
+    LinuxThreadPool<>,
+    LinuxThreadNumber<DEBUG_MODE>
+>;
+
+using LinuxInstrumentedPolicy = AsyncWorkPolicy
+<
+    Stamped<Data>,
+    PriorityQueue,
+    LinuxLock,
+    ScopedLocker,
+    LinuxSynchronizer<>,
+    LinuxThreadPool<>,
+    LinuxThreadNumber<DEBUG_MODE>,
+    std::function < void (std::shared_ptr < Stamped<Data> >) >,
+    LatencyInstrumentation<>
+>;
+
+using LinuxBoundedPolicy = AsyncWorkPolicy
+<
+    Data,
+    Bounded<1024, Overflow::Block>::Queue,
+    LinuxLock,
+    ScopedLocker,
+    LinuxSynchronizer<>,
+    LinuxThreadPool<>,
+    LinuxThreadNumber<DEBUG_MODE>
+>;
+
+// Demo priorities run from 1 to Maxval, at most 1000.
+using LinuxBucketPolicy = AsyncWorkPolicy
+<
+    Data,
+    Bucketed<1024>::Queue,
+    LinuxLock,
+    ScopedLocker,
+    LinuxSynchronizer<>,
+    LinuxThreadPool<>,
+    LinuxThreadNumber<DEBUG_MODE>
+>;
+
+using LinuxDaryHeapPolicy = AsyncWorkPolicy
+<
+    Data,
+    DaryHeap<4>::Queue,
+    LinuxLock,
+    ScopedLocker,
+    LinuxSynchronizer<>,
+    LinuxThreadPool<>,
+    LinuxThreadNumber<DEBUG_MODE>
+>;
+
+// One worker group per NUMA node, each on a node-local shard.
+using LinuxNumaPolicy = AsyncWorkPolicy
+<
+    Data,
+    NodeLocalPriorityQueue,
+    LinuxLock,
+    ScopedLocker,
+    LinuxSynchronizer<>,
+    LinuxThreadPool<std::function<void(void)>, NodePlacement>,
+    LinuxThreadNumber<DEBUG_MODE>
+>;
+
+using LinuxElasticPolicy = AsyncWorkPolicy
+<
+    Data,
+    PriorityQueue,
+    LinuxLock,
+    ScopedLocker,
+    LinuxSynchronizer<>,
+    LinuxThreadPool<>,
+    ElasticThreadNumber<1, 8>
+>;
+
+using LinuxCompletionPolicy = AsyncWorkPolicy
+<
+    Completable<Data>,
+    PriorityQueue,
+    LinuxLock,
+    ScopedLocker,
+    LinuxSynchronizer<>,
+    LinuxThreadPool<>,
+    LinuxThreadNumber<DEBUG_MODE>
+>;
+
+// Demo priorities run from 1 to Maxval; 1ms of waiting is worth one level.
+using LinuxDeadlinePolicy = AsyncWorkPolicy
+<
+    Deadlined<Data>,
+    EarliestDeadline<>::Queue,
+    LinuxLock,
+    ScopedLocker,
+    LinuxSynchronizer<>,
     LinuxThreadPool<>,
     LinuxThreadNumber<DEBUG_MODE>
 >;
 
+using LinuxTenantPolicy = AsyncWorkPolicy
+<
+    Tenanted<Data>,
+    Tenants<4>::Queue,
+    LinuxLock,
+    ScopedLocker,
+    LinuxSynchronizer<>,
+    LinuxThreadPool<>,
+    LinuxThreadNumber<DEBUG_MODE>
+>;
+
+using LinuxGraphPolicy = AsyncWorkPolicy
+<
+    Completable<Ranked<Data>>,
+    PriorityQueue,
+    LinuxLock,
+    ScopedLocker,
+    LinuxSynchronizer<>,
+    LinuxThreadPool<>,
+    LinuxThreadNumber<DEBUG_MODE>
+>;
+
+template < typename CallbackType >
+using LinuxInlinePolicy = AsyncWorkPolicy
+<
+    Data,
+    PriorityQueue,
+    LinuxLock,
+    ScopedLocker,
+    LinuxSynchronizer<>,
+    LinuxThreadPool<>,
+    LinuxThreadNumber<DEBUG_MODE>,
+    CallbackType
+>;
+
 #endif // __linux__
 
 #endif // __LINUX_POLICY_H__
\ No newline at end of file
@@ -0,0 +1,524 @@
+#if !defined( __LOGGER_H__ )
+#define __LOGGER_H__
+
+#include "Common.h"
+
+enum class LogLevel
+{
+    Trace,
+    Debug,
+    Info,
+    Warning,
+    Error,
+    Off
+};
+
+// Messages below LOG_LEVEL are compiled out. Debug builds trace every item,
+// release builds keep Info and above.
+#if !defined( LOG_LEVEL )
+#if defined( DEBUG_MODE ) && DEBUG_MODE
+#define LOG_LEVEL Trace
+#else
+#define LOG_LEVEL Info
+#endif
+#endif // LOG_LEVEL
+
+constexpr LogLevel CompiledLogLevel = LogLevel::LOG_LEVEL;
+
+// Text formatted at the call site, for arguments that cannot be copied bitwise.
+// Longer text, such as multi-line reports, goes to the heap and is freed by the
+// drain thread once it was formatted.
+struct LogText
+{
+    static constexpr size_t Capacity = 80;
+
+    char* spill;
+    size_t size;
+    char text[Capacity];
+
+    LogText(const std::string& s)
+    : LogText(s.data(), s.size())
+    {}
+
+    LogText(const char* s, size_t length)
+    : spill(length > Capacity ? new char[length] : nullptr)
+    , size(length)
+    {
+        std::memcpy(spill ? spill : text, s, size);
+    }
+
+    // Called once per record.
+    void Take(std::string& out) const
+    {
+        out.append(spill ? spill : text, size);
+        delete[] spill;
+    }
+};
+
+// A character array, such as a literal, copied whole; its size is known at
+// compile time, so it takes no more of the record than it needs.
+template < size_t Size >
+struct LogChars
+{
+    char text[Size];
+
+    LogChars(const char (&s)[Size])
+    {
+        std::memcpy(text, s, Size);
+    }
+
+    void Take(std::string& out) const
+    {
+        out.append(text, strnlen(text, Size));
+    }
+};
+
+// Text kept by pointer; only for text that outlives the drain thread, such as
+// a literal passed through a const char*.
+struct LogLiteral
+{
+    const char* text;
+
+    explicit LogLiteral(const char* s) : text(s) {}
+};
+
+template < typename Type, typename = void >
+struct HasPrintout : std::false_type {};
+
+template < typename Type >
+struct HasPrintout < Type, std::void_t < decltype(std::declval < const Type& >().Printout()) > > : std::true_type {};
+
+// Log arguments are copied into the caller's ring and formatted on the drain
+// thread, so nothing a message refers to has to outlive the call. Character
+// arrays, literals included, are copied whole when short and C strings behind a
+// pointer go into a LogText; only a LogLiteral is kept by pointer. Numbers and
+// trivially copyable items with Printout() are copied as they are; anything
+// else is formatted right away into a LogText.
+template < typename Type >
+struct LogArgument
+{
+    using Decayed = std::decay_t < Type >;
+
+    static constexpr bool CString = std::is_same < Decayed, char* >::value || std::is_same < Decayed, const char* >::value;
+    static constexpr bool ShortArray = CString && std::is_array < Type >::value && std::extent < Type >::value <= LogText::Capacity;
+
+    using StoredType = std::conditional_t
+    <
+        ShortArray,
+        LogChars < std::extent < Type >::value >,
+        std::conditional_t
+        <
+            !CString && (std::is_arithmetic < Decayed >::value ||
+                (std::is_trivially_copyable < Decayed >::value && HasPrintout < Decayed >::value) ||
+                std::is_same < Decayed, LogLiteral >::value),
+            Decayed,
+            LogText
+        >
+    >;
+
+    static StoredType Store(const Type& value)
+    {
+        if constexpr (ShortArray)
+            return StoredType(value);
+        else if constexpr (CString)
+            return LogText(value, strlen(value));
+        else if constexpr (std::is_same < StoredType, LogText >::value)
+        {
+            if constexpr (HasPrintout < Decayed >::value)
+                return LogText(value.Printout());
+            else
+                return LogText(std::string(value));
+        }
+        else
+            return value;
+    }
+
+    static void Format(std::string& out, const StoredType& value)
+    {
+        if constexpr (ShortArray || std::is_same < StoredType, LogText >::value)
+            value.Take(out);
+        else if constexpr (std::is_same < StoredType, LogLiteral >::value)
+            out += value.text;
+        else if constexpr (std::is_same < StoredType, char >::value)
+            out += value;
+        else if constexpr (std::is_arithmetic < StoredType >::value)
+            out += std::to_string(value);
+        else
+            out += value.Printout();
+    }
+};
+
+struct alignas(64) LogRecord
+{
+    static constexpr size_t PayloadSize = 112;
+
+    void (*format)(const unsigned char* payload, std::string& out);
+    long long stamp;
+    alignas(8) unsigned char payload[PayloadSize];
+};
+
+// Single producer, single consumer; unless the logger blocks, the owning thread
+// drops messages rather than wait for the drain when its ring is full.
+class LogRing
+{
+public:
+    static constexpr size_t Capacity = 1024;
+
+    LogRing() : m_head(0), m_retired(false), m_tail(0), m_dropped(0) {}
+
+    // Null when the ring is full.
+    LogRecord* Reserve()
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) == Capacity) return nullptr;
+
+        return &m_records[tail % Capacity];
+    }
+
+    void Drop()
+    {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // True when the drain had emptied the ring, so it may be parked.
+    bool Commit()
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return m_head.load(std::memory_order_acquire) == tail;
+    }
+
+    template < typename FunType >
+    size_t Consume(FunType&& fn)
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        size_t tail = m_tail.load(std::memory_order_acquire);
+        for (size_t i = head; i != tail; ++i)
+            fn(m_records[i % Capacity]);
+
+        m_head.store(tail, std::memory_order_release);
+        return tail - head;
+    }
+
+    bool Empty() const
+    {
+        return m_head.load(std::memory_order_relaxed) == m_tail.load(std::memory_order_acquire);
+    }
+
+    void Retire() { m_retired.store(true, std::memory_order_release); }
+    bool Retired() const { return m_retired.load(std::memory_order_acquire); }
+
+    unsigned long TakeDropped() { return m_dropped.exchange(0, std::memory_order_relaxed); }
+    unsigned long Dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+private:
+    alignas(64) std::atomic < size_t > m_head;
+    std::atomic < bool > m_retired;
+    alignas(64) std::atomic < size_t > m_tail;
+    std::atomic < unsigned long > m_dropped;
+    std::array < LogRecord, Capacity > m_records;
+};
+
+// Each logging thread gets its own ring on first use. A background thread drains
+// the rings, formats the records in timestamp order and hands them to the file
+// descriptor with one writev per batch. Once the rings are empty it parks until
+// a thread commits to an empty ring again.
+class Logger
+{
+public:
+    static Logger& Instance()
+    {
+        static Logger s_logger;
+        return s_logger;
+    }
+
+    // Where the drain thread writes, standard output unless told otherwise.
+    // Returns the previous descriptor.
+    int SetDescriptor(int fd)
+    {
+        return m_fd.exchange(fd, std::memory_order_relaxed);
+    }
+
+    // When set, a thread whose ring is full yields until the drain made room
+    // instead of dropping the message. Off by default, as logging then stalls
+    // callers whenever the drain falls behind.
+    void SetBlocking(bool blocking)
+    {
+        m_blocking.store(blocking, std::memory_order_relaxed);
+    }
+
+    template < typename ... Args >
+    void Write(const Args& ... args)
+    {
+        using PayloadType = std::tuple < typename LogArgument < Args >::StoredType ... >;
+        static_assert(sizeof(PayloadType) <= LogRecord::PayloadSize, "Log message arguments do not fit into a record.");
+        static_assert(alignof(PayloadType) <= 8, "Log message arguments are overaligned.");
+
+        LogRing& ring = Own();
+        LogRecord* record = ring.Reserve();
+        for (; !record; record = ring.Reserve())
+        {
+            if (!m_blocking.load(std::memory_order_relaxed))
+            {
+                ring.Drop();
+                return;
+            }
+
+            Wake();
+            std::this_thread::yield();
+        }
+
+        record->format = &FormatRecord < Args ... >;
+        record->stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+        new (record->payload) PayloadType(LogArgument < Args >::Store(args) ...);
+        if (ring.Commit())
+            Wake();
+    }
+
+    // Waits until the drain wrote every message committed before the call: the
+    // pass running now may have missed them, the one after may not.
+    void Sync()
+    {
+        unsigned long pass = m_passes.load(std::memory_order_acquire);
+        while (m_passes.load(std::memory_order_acquire) < pass + 2)
+        {
+            Wake();
+            std::this_thread::yield();
+        }
+    }
+
+    // Messages dropped so far because their thread's ring was full.
+    unsigned long Dropped()
+    {
+        std::unique_lock < std::mutex > lk(m_l);
+        unsigned long dropped = m_dropped;
+        for (const std::unique_ptr < LogRing >& ring : m_rings)
+            dropped += ring->Dropped();
+
+        return dropped;
+    }
+
+    ~Logger()
+    {
+        m_stopping.store(true, std::memory_order_release);
+        {
+            std::unique_lock < std::mutex > lk(m_park_lock);
+            m_wake.notify_one();
+        }
+        m_drain.join();
+    }
+
+private:
+    struct RingHolder
+    {
+        LogRing* ring = nullptr;
+        ~RingHolder() { if (ring) ring->Retire(); }
+    };
+
+    struct Entry
+    {
+        long long stamp;
+        std::string text;
+    };
+
+    Logger()
+    : m_fd(1)
+    , m_stopping(false)
+    , m_blocking(false)
+    , m_parked(false)
+    , m_passes(0)
+    , m_dropped(0)
+    , m_drain(&Logger::Drain, this)
+    {}
+
+    template < typename ... Args >
+    static void FormatRecord(const unsigned char* payload, std::string& out)
+    {
+        using PayloadType = std::tuple < typename LogArgument < Args >::StoredType ... >;
+        const PayloadType& values = *reinterpret_cast < const PayloadType* >(payload);
+
+        std::apply([&out](const auto& ... value)
+        {
+            (LogArgument < Args >::Format(out, value), ...);
+        }, values);
+        out += '\n';
+    }
+
+    LogRing& Own()
+    {
+        static thread_local RingHolder s_holder;
+        if (!s_holder.ring)
+        {
+            std::unique_lock < std::mutex > lk(m_l);
+            m_rings.push_back(std::make_unique < LogRing >());
+            s_holder.ring = m_rings.back().get();
+        }
+
+        return *s_holder.ring;
+    }
+
+    void Drain()
+    {
+        std::vector < Entry > entries;
+        size_t used = 0;
+
+        for (;;)
+        {
+            bool stopping = m_stopping.load(std::memory_order_acquire);
+            unsigned long dropped = 0;
+            used = 0;
+            {
+                std::unique_lock < std::mutex > lk(m_l);
+                for (const std::unique_ptr < LogRing >& ring : m_rings)
+                {
+                    ring->Consume([&](const LogRecord& record)
+                    {
+                        if (used == entries.size()) entries.emplace_back();
+
+                        Entry& entry = entries[used++];
+                        entry.stamp = record.stamp;
+                        entry.text.clear();
+                        record.format(record.payload, entry.text);
+                    });
+                    dropped += ring->TakeDropped();
+                }
+                m_dropped += dropped;
+
+                m_rings.erase(std::remove_if(std::begin(m_rings), std::end(m_rings),
+                    [](const std::unique_ptr < LogRing >& ring) { return ring->Retired() && ring->Empty(); }),
+                    std::end(m_rings));
+            }
+
+            if (dropped)
+            {
+                if (used == entries.size()) entries.emplace_back();
+                entries[used].stamp = std::numeric_limits < long long >::max();
+                entries[used++].text = "Logger dropped " + std::to_string(dropped) + " messages.\n";
+            }
+
+            if (used)
+            {
+                std::stable_sort(std::begin(entries), std::begin(entries) + used,
+                    [](const Entry& lhs, const Entry& rhs) { return lhs.stamp < rhs.stamp; });
+                Flush(entries, used);
+            }
+            else if (stopping)
+                break;
+
+            m_passes.fetch_add(1, std::memory_order_release);
+            if (!used)
+                Park();
+        }
+    }
+
+    // The fences pair a producer committing to an empty ring with the drain
+    // parking; the timeout only covers a producer that read a stale head.
+    void Wake()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!m_parked.load(std::memory_order_relaxed)) return;
+
+        std::unique_lock < std::mutex > lk(m_park_lock);
+        m_wake.notify_one();
+    }
+
+    void Park()
+    {
+        std::unique_lock < std::mutex > lk(m_park_lock);
+        m_parked.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (!m_stopping.load(std::memory_order_acquire) && !Pending())
+            m_wake.wait_for(lk, MaxPark);
+
+        m_parked.store(false, std::memory_order_relaxed);
+    }
+
+    bool Pending()
+    {
+        std::unique_lock < std::mutex > lk(m_l);
+        return std::any_of(std::begin(m_rings), std::end(m_rings),
+            [](const std::unique_ptr < LogRing >& ring) { return !ring->Empty() || ring->Dropped(); });
+    }
+
+    void Flush(const std::vector < Entry >& entries, size_t count)
+    {
+        for (size_t first = 0; first < count; first += MaxBatch)
+        {
+            size_t last = std::min(count, first + MaxBatch);
+#if defined( __linux__ )
+            std::array < iovec, MaxBatch > iov;
+            for (size_t i = first; i < last; ++i)
+            {
+                iov[i - first].iov_base = const_cast < char* >(entries[i].text.data());
+                iov[i - first].iov_len = entries[i].text.size();
+            }
+
+            WriteAll(iov.data(), static_cast < int >(last - first));
+#else
+            for (size_t i = first; i < last; ++i)
+                _write(m_fd.load(std::memory_order_relaxed), entries[i].text.data(), static_cast < unsigned int >(entries[i].text.size()));
+#endif // __linux__
+        }
+    }
+
+#if defined( __linux__ )
+    // writev may stop short on pipes and signals; resume where it left off.
+    void WriteAll(iovec* iov, int count)
+    {
+        int fd = m_fd.load(std::memory_order_relaxed);
+        while (count)
+        {
+            ssize_t written = writev(fd, iov, count);
+            if (written < 0)
+            {
+                if (errno == EINTR) continue;
+                return;
+            }
+
+            while (count && static_cast < size_t >(written) >= iov->iov_len)
+            {
+                written -= iov->iov_len;
+                ++iov;
+                --count;
+            }
+
+            if (count)
+            {
+                iov->iov_base = static_cast < char* >(iov->iov_base) + written;
+                iov->iov_len -= written;
+            }
+        }
+    }
+#endif // __linux__
+
+    static constexpr size_t MaxBatch = 256;
+    static constexpr std::chrono::milliseconds MaxPark { 100 };
+
+    std::atomic < int > m_fd;
+    std::atomic < bool > m_stopping;
+    std::atomic < bool > m_blocking;
+    std::mutex m_park_lock;
+    std::condition_variable m_wake;
+    std::atomic < bool > m_parked;
+    std::atomic < unsigned long > m_passes;
+    std::mutex m_l;
+    std::vector < std::unique_ptr < LogRing > > m_rings;
+    unsigned long m_dropped;
+    std::thread m_drain;
+};
+
+template < LogLevel Level, typename ... Args >
+inline void Log(const Args& ... args)
+{
+    if constexpr (Level >= CompiledLogLevel && Level != LogLevel::Off)
+        Logger::Instance().Write(args ...);
+}
+
+template < typename ... Args > inline void LogTrace(const Args& ... args) { Log < LogLevel::Trace >(args ...); }
+template < typename ... Args > inline void LogDebug(const Args& ... args) { Log < LogLevel::Debug >(args ...); }
+template < typename ... Args > inline void LogInfo(const Args& ... args) { Log < LogLevel::Info >(args ...); }
+template < typename ... Args > inline void LogWarning(const Args& ... args) { Log < LogLevel::Warning >(args ...); }
+template < typename ... Args > inline void LogError(const Args& ... args) { Log < LogLevel::Error >(args ...); }
+
+#endif // __LOGGER_H__
@@ -0,0 +1,161 @@
+#if !defined( __OBJECT_POOL_H__ )
+#define __OBJECT_POOL_H__
+
+#include "Policy.h"
+
+template < typename DataType > class ObjectPool;
+
+template < typename DataType > struct PoolSlot
+{
+    typename std::aligned_storage < sizeof(DataType), alignof(DataType) >::type storage;
+    ObjectPool < DataType >* pool;
+    std::atomic < unsigned int > next;
+
+    DataType* Get()
+    {
+        return reinterpret_cast < DataType* >(&storage);
+    }
+};
+
+// Move-only owning handle to a pooled object. The slot knows its pool, so the
+// handle is a single pointer and releasing needs no reference counting.
+template < typename DataType > class PoolPtr
+{
+    PoolSlot < DataType >* m_slot;
+public:
+    PoolPtr() : m_slot(nullptr) {}
+    explicit PoolPtr(PoolSlot < DataType >* slot) : m_slot(slot) {}
+
+    PoolPtr(PoolPtr&& other) noexcept : m_slot(other.m_slot)
+    {
+        other.m_slot = nullptr;
+    }
+
+    PoolPtr& operator= (PoolPtr&& other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            m_slot = other.m_slot;
+            other.m_slot = nullptr;
+        }
+
+        return *this;
+    }
+
+    PoolPtr(const PoolPtr&) = delete;
+    PoolPtr& operator= (const PoolPtr&) = delete;
+
+    ~PoolPtr()
+    {
+        reset();
+    }
+
+    void reset();
+
+    DataType* get() const { return m_slot ? m_slot->Get() : nullptr; }
+    DataType* operator->() const { return m_slot->Get(); }
+    DataType& operator*() const { return *m_slot->Get(); }
+    explicit operator bool() const { return m_slot != nullptr; }
+};
+
+// Fixed-capacity pool with a lock-free free list. The list head packs a slot
+// index (1-based, 0 means empty) with a modification tag against ABA.
+template < typename DataType > class ObjectPool
+{
+    static constexpr unsigned long long IndexMask = 0xffffffffull;
+
+    size_t m_capacity;
+    std::unique_ptr < PoolSlot < DataType >[] > m_slots;
+    alignas(64) std::atomic < unsigned long long > m_head;
+public:
+    static constexpr size_t DefaultCapacity = 1 << 16;
+
+    ObjectPool(size_t capacity = DefaultCapacity)
+    : m_capacity(capacity)
+    , m_slots(new PoolSlot < DataType >[capacity])
+    , m_head(capacity ? 1 : 0)
+    {
+        for (size_t i = 0; i < m_capacity; ++i)
+        {
+            m_slots[i].pool = this;
+            m_slots[i].next.store(static_cast < unsigned int >((i + 1 < m_capacity) ? i + 2 : 0), std::memory_order_relaxed);
+        }
+    }
+
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator= (const ObjectPool&) = delete;
+
+    size_t Capacity() const { return m_capacity; }
+
+    template < typename ... Args >
+    PoolPtr < DataType > Make(Args&& ... args)
+    {
+        PoolSlot < DataType >* slot = Pop();
+        if (!slot) throw std::bad_alloc();
+
+        try
+        {
+            new (&slot->storage) DataType(std::forward < Args >(args) ...);
+        }
+        catch (...)
+        {
+            Push(slot);
+            throw;
+        }
+
+        return PoolPtr < DataType >(slot);
+    }
+
+    void Release(PoolSlot < DataType >* slot)
+    {
+        slot->Get()->~DataType();
+        Push(slot);
+    }
+
+private:
+    PoolSlot < DataType >* Pop()
+    {
+        unsigned long long head = m_head.load(std::memory_order_acquire);
+        for (;;)
+        {
+            unsigned long long index = head & IndexMask;
+            if (!index) return nullptr;
+
+            unsigned long long next = m_slots[index - 1].next.load(std::memory_order_relaxed);
+            unsigned long long desired = ((head & ~IndexMask) + (IndexMask + 1)) | next;
+            if (m_head.compare_exchange_weak(head, desired, std::memory_order_acquire))
+                return &m_slots[index - 1];
+        }
+    }
+
+    void Push(PoolSlot < DataType >* slot)
+    {
+        unsigned long long index = static_cast < unsigned long long >(slot - m_slots.get()) + 1;
+        unsigned long long head = m_head.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            slot->next.store(static_cast < unsigned int >(head & IndexMask), std::memory_order_relaxed);
+            unsigned long long desired = ((head & ~IndexMask) + (IndexMask + 1)) | index;
+            if (m_head.compare_exchange_weak(head, desired, std::memory_order_release))
+                return;
+        }
+    }
+};
+
+template < typename DataType >
+void PoolPtr < DataType >::reset()
+{
+    if (m_slot)
+    {
+        m_slot->pool->Release(m_slot);
+        m_slot = nullptr;
+    }
+}
+
+template < typename DataType > struct ItemAllocator < PoolPtr < DataType > > : ObjectPool < DataType > {};
+
+template < typename DataType >
+using PooledPriorityQueue = BasicPriorityQueue < DataType, PoolPtr < DataType > >;
+
+#endif // __OBJECT_POOL_H__
@@ -0,0 +1,197 @@
+#if !defined( __PARALLEL_H__ )
+#define __PARALLEL_H__
+
+#include "Common.h"
+
+// One data-parallel loop over [0, size), kept on the caller's stack while the
+// policy's workers help with it. Chunks are claimed from a shared cursor with
+// guided sizes: each claim takes remaining / (2 * parts) indices, at least
+// grain, so the first chunks are large and the tail still balances.
+class ParallelJob
+{
+public:
+    using RunType = void (*)(void* context, size_t begin, size_t end);
+
+    // Ranges up to this size are not split by default.
+    static constexpr size_t DefaultGrain = 1024;
+
+    ParallelJob(size_t size, size_t grain, int parts, RunType run, void* context)
+    : m_next(0)
+    , m_size(size)
+    , m_grain(std::max < size_t >(grain, 1))
+    , m_parts(static_cast < size_t >(std::max(parts, 1)) * 2)
+    , m_run(run)
+    , m_context(context)
+    {}
+
+    ParallelJob(const ParallelJob&) = delete;
+    ParallelJob& operator= (const ParallelJob&) = delete;
+
+    // Runs chunks until none are left to claim. The first exception stops the
+    // loop; Rethrow hands it to the caller.
+    void Help()
+    {
+        size_t begin;
+        size_t end;
+        while (Claim(begin, end))
+        {
+            try
+            {
+                m_run(m_context, begin, end);
+            }
+            catch (...)
+            {
+                Fail(std::current_exception());
+            }
+        }
+    }
+
+    bool Open() const
+    {
+        return m_next.load(std::memory_order_relaxed) < m_size;
+    }
+
+    void Rethrow()
+    {
+        if (m_error) std::rethrow_exception(m_error);
+    }
+
+private:
+    bool Claim(size_t& begin, size_t& end)
+    {
+        size_t next = m_next.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            if (next >= m_size) return false;
+
+            size_t chunk = std::min(std::max((m_size - next) / m_parts, m_grain), m_size - next);
+            if (m_next.compare_exchange_weak(next, next + chunk, std::memory_order_relaxed))
+            {
+                begin = next;
+                end = next + chunk;
+                return true;
+            }
+        }
+    }
+
+    void Fail(std::exception_ptr error)
+    {
+        std::unique_lock < std::mutex > lk(m_lock);
+        if (!m_error) m_error = error;
+        m_next.store(m_size, std::memory_order_relaxed);
+    }
+
+    alignas(64) std::atomic < size_t > m_next;
+    size_t m_size;
+    size_t m_grain;
+    size_t m_parts;
+    RunType m_run;
+    void* m_context;
+    std::mutex m_lock;
+    std::exception_ptr m_error;
+};
+
+// Loops open for helping, one per slot. Helpers count themselves in the slot
+// before looking at its loop, so once the owner took the loop out and the count
+// dropped to zero nobody touches it any more. Waiters sleep on one condition
+// variable, which leaving helpers only touch while somebody waits.
+class ParallelBoard
+{
+public:
+    static constexpr int Slots = 8;
+
+    ParallelBoard()
+    : m_open(0)
+    , m_waiters(0)
+    {}
+
+    ParallelBoard(const ParallelBoard&) = delete;
+    ParallelBoard& operator= (const ParallelBoard&) = delete;
+
+    // The slot taken, or -1 when all are; the owner then runs the loop alone.
+    int Publish(ParallelJob* job)
+    {
+        for (int i = 0; i < Slots; ++i)
+        {
+            bool owned = false;
+            if (!m_slots[i].owned.compare_exchange_strong(owned, true)) continue;
+
+            m_slots[i].job.store(job);
+            m_open.fetch_add(1);
+            return i;
+        }
+
+        return -1;
+    }
+
+    // Takes the loop out of its slot; helpers may still be running chunks of it.
+    void Withdraw(int slot)
+    {
+        m_slots[slot].job.store(nullptr);
+        m_open.fetch_sub(1);
+    }
+
+    bool Busy(int slot) const
+    {
+        return m_slots[slot].users.load() != 0;
+    }
+
+    // After Withdraw, once the slot is no longer busy.
+    void Release(int slot)
+    {
+        m_slots[slot].owned.store(false, std::memory_order_release);
+    }
+
+    // Helps one open loop until its chunks are all claimed; false when there was none.
+    bool Help()
+    {
+        if (!m_open.load(std::memory_order_relaxed)) return false;
+
+        for (Slot& slot : m_slots)
+        {
+            if (!slot.job.load(std::memory_order_relaxed)) continue;
+
+            slot.users.fetch_add(1);
+            ParallelJob* job = slot.job.load();
+            bool helped = job && job->Open();
+            if (helped) job->Help();
+            Leave(slot);
+
+            if (helped) return true;
+        }
+
+        return false;
+    }
+
+    void Wait(int slot)
+    {
+        std::unique_lock < std::mutex > lk(m_lock);
+        m_waiters.fetch_add(1);
+        m_idle.wait(lk, [this, slot]() { return !Busy(slot); });
+        m_waiters.fetch_sub(1);
+    }
+
+private:
+    struct alignas(64) Slot
+    {
+        std::atomic < ParallelJob* > job { nullptr };
+        std::atomic < int > users { 0 };
+        std::atomic < bool > owned { false };
+    };
+
+    void Leave(Slot& slot)
+    {
+        if (slot.users.fetch_sub(1) != 1 || !m_waiters.load()) return;
+
+        std::unique_lock < std::mutex > lk(m_lock);
+        m_idle.notify_all();
+    }
+
+    Slot m_slots[Slots];
+    std::atomic < int > m_open;
+    std::atomic < int > m_waiters;
+    std::mutex m_lock;
+    std::condition_variable m_idle;
+};
+
+#endif // __PARALLEL_H__
@@ -2,6 +2,9 @@
 #define  __POLICY_H__
 
 #include "Common.h"
+#include "Logger.h"
+#include "Completion.h"
+#include "Parallel.h"
 
 class SystemException final : public std::exception
 {
@@ -65,6 +68,278 @@ public:
     }
 };
 
+template < typename ItemType > class ItemSpan
+{
+    ItemType* m_data;
+    size_t m_size;
+public:
+    ItemSpan(ItemType* data, size_t size) : m_data(data), m_size(size) {}
+
+    ItemType* begin() const { return m_data; }
+    ItemType* end() const { return m_data + m_size; }
+    size_t size() const { return m_size; }
+    bool empty() const { return !m_size; }
+    ItemType& operator[](size_t i) const { return m_data[i]; }
+};
+
+// Queue items are either pointer-like handles or the data values themselves.
+template < typename ItemType, typename = void >
+struct IsItemHandle : std::false_type {};
+
+template < typename ItemType >
+struct IsItemHandle < ItemType, std::void_t < decltype(*std::declval < ItemType& >()) > > : std::true_type {};
+
+template < typename ItemType >
+decltype(auto) ItemRef(ItemType& item)
+{
+    if constexpr (IsItemHandle < ItemType >::value)
+        return (*item);
+    else
+        return (item);
+}
+
+// Creates queue items for AsyncWorkPolicy::Make, specialized per handle type.
+template < typename ItemType > struct ItemAllocator {};
+
+template < typename DataType > struct ItemAllocator < std::shared_ptr < DataType > >
+{
+    template < typename ... Args >
+    std::shared_ptr < DataType > Make(Args&& ... args)
+    {
+        return std::make_shared < DataType >(std::forward < Args >(args) ...);
+    }
+};
+
+class NullLock;
+class NullSync;
+
+// Thread pools exposing Rebind get the policy's concrete entry functor instead
+// of a std::function.
+template < typename ThreadPoolType, typename EntryType, typename = void >
+struct ReboundThreadPool
+{
+    using Type = ThreadPoolType;
+};
+
+template < typename ThreadPoolType, typename EntryType >
+struct ReboundThreadPool < ThreadPoolType, EntryType, std::void_t < typename ThreadPoolType::template Rebind < EntryType > > >
+{
+    using Type = typename ThreadPoolType::template Rebind < EntryType >;
+};
+
+template < typename QueueType, typename = void >
+struct IsSelfSynchronized : std::false_type {};
+
+template < typename QueueType >
+struct IsSelfSynchronized < QueueType, std::void_t < decltype(QueueType::SelfSynchronized) > >
+    : std::bool_constant < QueueType::SelfSynchronized > {};
+
+// Default instrumentation of AsyncWorkPolicy; every hook is empty and compiles away.
+// See Instrumentation.h for the measuring one.
+class NoInstrumentation
+{
+public:
+    struct Probe {};
+
+    struct SnapshotType
+    {
+        std::string Printout() const { return std::string(); }
+    };
+
+    template < typename ... Args >
+    NoInstrumentation(Args&& ...) {}
+
+    template < typename ItemType > void Stamp(const ItemType&) {}
+    void OnEnqueue(int) {}
+    template < typename ItemType > void OnDequeue(const ItemType&) {}
+    template < typename ItemType > Probe Begin(const ItemType&) { return Probe(); }
+    void End(const Probe&, int = 1) {}
+
+    SnapshotType Snapshot() const { return SnapshotType(); }
+};
+
+inline long long MonotonicNs()
+{
+    return std::chrono::duration_cast < std::chrono::nanoseconds >(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// CPU time the calling thread has used.
+inline long long ThreadCpuNs()
+{
+#if defined( __linux__ )
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+#else
+    FILETIME creation, exit, kernel, user;
+    GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user);
+    ULARGE_INTEGER k { { kernel.dwLowDateTime, kernel.dwHighDateTime } };
+    ULARGE_INTEGER u { { user.dwLowDateTime, user.dwHighDateTime } };
+    return static_cast < long long >(k.QuadPart + u.QuadPart) * 100;
+#endif // __linux__
+}
+
+enum class WaitResult
+{
+    Acquired,
+    Timeout,
+    Stopped
+};
+
+// What AsyncWorkPolicy does with an item offered to a full bounded queue.
+enum class Overflow
+{
+    Block,          // Perform waits for a free slot.
+    FailFast,       // Perform returns false at once; PerformFor waits up to its timeout.
+    DropLowest,     // The lowest priority item, queued or offered, is discarded.
+    DropNew         // The offered item is discarded.
+};
+
+// Bounded queues report Capacity and OverflowMode, and offer Full, LowestPriority
+// and DropLowest to the policy.
+template < typename QueueType, typename = void >
+struct IsBoundedQueue : std::false_type {};
+
+template < typename QueueType >
+struct IsBoundedQueue < QueueType, std::void_t < decltype(QueueType::OverflowMode) > > : std::true_type {};
+
+// Queues limiting how many items of a class run at once (BasicTenantQueue) are
+// told when a callback returned.
+template < typename QueueType, typename = void >
+struct IsClassedQueue : std::false_type {};
+
+template < typename QueueType >
+struct IsClassedQueue < QueueType, std::void_t < decltype(std::declval < QueueType& >().Finished(0)) > > : std::true_type {};
+
+// Queues keeping per-item statistics (BasicDeadlineQueue) are told when an item
+// is handed to its callback, rather than counting it on Dequeue.
+template < typename QueueType, typename = void >
+struct IsDispatchAware : std::false_type {};
+
+template < typename QueueType >
+struct IsDispatchAware < QueueType, std::void_t < decltype(std::declval < const QueueType& >().Dispatched(
+    std::declval < const typename QueueType::DataPtrType& >())) > > : std::true_type {};
+
+// Queues whose order depends on when an item was enqueued put an item back
+// under its original key with Requeue.
+template < typename QueueType, typename = void >
+struct IsRequeueable : std::false_type {};
+
+template < typename QueueType >
+struct IsRequeueable < QueueType, std::void_t < decltype(std::declval < QueueType& >().Requeue(
+    std::declval < typename QueueType::DataPtrType&& >())) > > : std::true_type {};
+
+template < typename QueueType, bool = IsBoundedQueue < QueueType >::value >
+struct QueueOverflowMode : std::integral_constant < Overflow, Overflow::Block > {};
+
+template < typename QueueType >
+struct QueueOverflowMode < QueueType, true > : std::integral_constant < Overflow, QueueType::OverflowMode > {};
+
+// Worker count that follows the load. The pool starts with MinWorkers and grows by
+// one worker when more than DepthPerWorker items per worker are queued, or when
+// no worker is idle and nothing was dequeued for StallMicroseconds, i.e. the
+// callbacks block. Past one worker per online CPU the pool only grows while most
+// callbacks spend less than half their time on a CPU, so CPU-bound callbacks
+// do not oversubscribe the cores. A worker idle for
+// IdleMilliseconds retires while more than MinWorkers remain.
+template < int MinWorkers, int MaxWorkers, int DepthPerWorker = 4, int StallMicroseconds = 1000, int IdleMilliseconds = 2000 >
+struct ElasticThreadNumber
+{
+    static_assert(MinWorkers >= 1 && MinWorkers <= MaxWorkers, "an elastic pool needs 1 <= MinWorkers <= MaxWorkers");
+
+    static constexpr bool Elastic = true;
+
+    static int Get() { return MinWorkers; }
+    static int Max() { return MaxWorkers; }
+    static int Depth() { return DepthPerWorker; }
+    static std::chrono::nanoseconds Stall() { return std::chrono::microseconds(StallMicroseconds); }
+    static std::chrono::nanoseconds Idle() { return std::chrono::milliseconds(IdleMilliseconds); }
+
+    static int Cores()
+    {
+        static const int s_cores = std::max(static_cast < int >(std::thread::hardware_concurrency()), 1);
+        return s_cores;
+    }
+};
+
+template < typename ThreadNumber, typename = void >
+struct IsElastic : std::false_type {};
+
+template < typename ThreadNumber >
+struct IsElastic < ThreadNumber, std::void_t < decltype(ThreadNumber::Elastic) > >
+    : std::bool_constant < ThreadNumber::Elastic > {};
+
+// Current size of a policy's pool; grown and retired stay 0 for fixed pools.
+struct PoolStatus
+{
+    int workers;
+    int idle;
+    long pending;
+    unsigned long grown;
+    unsigned long retired;
+
+    std::string Printout() const
+    {
+        std::stringstream sstm;
+        sstm << "Workers: " << workers << ", idle: " << idle << ", pending: " << pending
+            << ", grown: " << grown << ", retired: " << retired << ".";
+        return sstm.str();
+    }
+};
+
+enum class ShutdownMode
+{
+    DrainAll,       // Workers process everything queued.
+    DrainUntil,     // Workers take items until the timeout passes.
+    DrainAbove,     // Workers take items down to minPriority.
+    Abort           // Workers only finish their current callbacks.
+};
+
+struct ShutdownOptions
+{
+    ShutdownMode mode = ShutdownMode::DrainAll;
+    std::chrono::nanoseconds timeout = std::chrono::nanoseconds::max();
+    int minPriority = std::numeric_limits < int >::min();
+
+    static ShutdownOptions Until(std::chrono::nanoseconds timeout)
+    {
+        return ShutdownOptions { ShutdownMode::DrainUntil, timeout };
+    }
+
+    static ShutdownOptions Above(int minPriority)
+    {
+        return ShutdownOptions { ShutdownMode::DrainAbove, std::chrono::nanoseconds::max(), minPriority };
+    }
+
+    static ShutdownOptions Abort()
+    {
+        return ShutdownOptions { ShutdownMode::Abort };
+    }
+};
+
+// What AsyncWorkPolicy::Shutdown did; the items left in the queue are handed back.
+template < typename ItemType >
+struct ShutdownReport
+{
+    unsigned long drained;
+    std::chrono::nanoseconds elapsed;
+    std::vector < ItemType > leftovers;
+
+    size_t Left() const
+    {
+        return leftovers.size();
+    }
+
+    std::string Printout() const
+    {
+        std::stringstream sstm;
+        sstm << "Shutdown drained " << drained << " item(s), left " << Left() << " in "
+            << std::chrono::duration_cast < std::chrono::microseconds >(elapsed).count() << " us.";
+        return sstm.str();
+    }
+};
+
 template
 <
     typename DataType,
@@ -73,106 +348,1193 @@ template
     template < typename > typename LockerType,
     typename SyncType,
     typename ThreadPoolType,
-    typename ThreadNumber
+    typename ThreadNumber,
+    typename CallbackType = std::function < void (typename QueueType< DataType >::DataPtrType) >,
+    typename InstrumentationType = NoInstrumentation
 >
 class AsyncWorkPolicy
 {
-    using CallbackType =
-    std::function
-    <
-    void (typename QueueType< DataType >::DataPtrType)
-    >;
+public:
+    using DataPtrType = typename QueueType< DataType >::DataPtrType;
+
+    // Queues which guard themselves make the external lock redundant, so it is
+    // replaced with NullLock and LockerType compiles down to nothing.
+    static constexpr bool SelfSynchronized = IsSelfSynchronized< QueueType< DataType > >::value;
+
+    // Value queues store DataType itself and hand out std::optional from Dequeue.
+    static constexpr bool ValueItems = !IsItemHandle< DataPtrType >::value;
+
+    static constexpr bool BoundedQueue = IsBoundedQueue< QueueType< DataType > >::value;
+    static constexpr Overflow OverflowMode = QueueOverflowMode< QueueType< DataType > >::value;
+
+    // Elastic ThreadNumber types make the pool grow and shrink, see ElasticThreadNumber.
+    static constexpr bool ElasticPool = IsElastic< ThreadNumber >::value;
+
+    static constexpr bool ClassedQueue = IsClassedQueue< QueueType< DataType > >::value;
+    static constexpr bool DispatchAware = IsDispatchAware< QueueType< DataType > >::value;
+
+    // Completable< Data, ResultType > items can be queued with Submit.
+    static constexpr bool Completes = IsCompletable< DataType >::value;
+    using CompletionType = Completion < typename IsCompletable< DataType >::ResultType >;
+
+private:
+    // Block and FailFast count free slots in a second synchronizer, which
+    // producers wait on and workers signal.
+    static constexpr bool CountsSlots = BoundedQueue &&
+        (OverflowMode == Overflow::Block || OverflowMode == Overflow::FailFast);
+
+    static constexpr long long WaitForever = -1;
+    static constexpr long long DefaultTimeout =
+        (BoundedQueue && OverflowMode == Overflow::FailFast) ? 0 : WaitForever;
+
+    using SpaceSyncType = std::conditional_t < CountsSlots, SyncType, NullSync >;
+
+    using ResultType = decltype(std::declval < QueueType< DataType >& >().Dequeue());
+    using BatchCallbackType = std::function < void (ItemSpan < DataPtrType >) >;
+    using QueueLockType = std::conditional_t < SelfSynchronized, NullLock, LockType >;
+
+    struct ThreadEntry
+    {
+        AsyncWorkPolicy* self;
+        void operator()() const { self->ThreadPoolCallback(); }
+    };
+
+    using PoolType = typename ReboundThreadPool < ThreadPoolType, ThreadEntry >::Type;
+
+    // Pending and idle counts, the last dequeue time and how many timed callbacks
+    // mostly waited are only kept for elastic pools.
+    struct PoolState
+    {
+        std::atomic < int > workers { 0 };
+        std::atomic < int > idle { 0 };
+        std::atomic < long > pending { 0 };
+        std::atomic < long long > lastDequeue { 0 };
+        std::atomic < long > timed { 0 };
+        std::atomic < long > waited { 0 };
+        std::atomic < long long > sampledAt { 0 };
+        std::atomic < bool > blocking { false };
+        std::atomic < unsigned long > grown { 0 };
+        std::atomic < unsigned long > retired { 0 };
+    };
+
+    using CompletionResultType = typename IsCompletable< DataType >::ResultType;
+
+    Exceptioning m_excp;
+    typename IsCompletable< DataType >::PoolType m_completions;
+    ItemAllocator< DataPtrType > m_allocator;
+    QueueType< DataType > m_queue;
+    CallbackType m_callback;
+    BatchCallbackType m_batch_callback;
+    int m_batch_size;
+    QueueLockType m_lock;
+    SyncType m_sync;
+    SpaceSyncType m_space;
+    std::atomic < unsigned long > m_dropped;
+    InstrumentationType m_instrumentation;
+    PoolState m_pool_state;
+    std::atomic < bool > m_close_claimed;
+    std::atomic < bool > m_closing;
+    std::atomic < long > m_submitting;
+    std::atomic < unsigned long > m_drained;
+    ShutdownOptions m_shutdown;
+    long long m_drain_deadline;
+    ParallelBoard m_board;
+    PoolType m_thread_pool;
+public:
+    // CallbackType may be any callable type; a lambda or functor type given here is
+    // called directly from the worker loop and can be inlined there.
+    AsyncWorkPolicy(CallbackType&& callback)
+    : AsyncWorkPolicy(std::move(callback), BatchCallbackType(), 1)
+    {}
+
+    // Workers drain up to batchSize items per wake-up and hand them over at once.
+    AsyncWorkPolicy(BatchCallbackType&& callback, int batchSize)
+    : AsyncWorkPolicy(CallbackType(), std::move(callback), std::max(batchSize, 1))
+    {}
+
+private:
+    AsyncWorkPolicy(CallbackType&& callback, BatchCallbackType&& batchCallback, int batchSize)
+    : m_queue(CreateQueue())
+    , m_callback(std::move(callback))
+    , m_batch_callback(std::move(batchCallback))
+    , m_batch_size(batchSize)
+    , m_sync(MaxWorkers())
+    , m_space(MaxWorkers())
+    , m_dropped(0)
+    , m_instrumentation(MaxWorkers())
+    , m_close_claimed(false)
+    , m_closing(false)
+    , m_submitting(0)
+    , m_drained(0)
+    , m_drain_deadline(std::numeric_limits < long long >::max())
+    , m_thread_pool(ThreadNumber::Get(), ThreadEntry { this })
+    {
+        m_pool_state.workers.store(ThreadNumber::Get(), std::memory_order_relaxed);
+        m_pool_state.lastDequeue.store(MonotonicNs(), std::memory_order_relaxed);
+
+        try
+        {
+            if constexpr (CountsSlots)
+                m_space.Signal(static_cast < int >(QueueType< DataType >::Capacity));
+
+            m_thread_pool.Start();
+            LogDebug("Starting policy.");
+        }
+        catch (std::exception &)
+        {
+            m_excp.Add(std::current_exception());
+        }
+    }
+
+public:
+    // Producers still inside Emplace, Perform or PerformBatch, such as callbacks
+    // queueing more work, are waited for before the pool joins its workers.
+    ~AsyncWorkPolicy()
+    {
+        Stop();
+        while (m_submitting.load())
+            std::this_thread::yield();
+    }
+
+    void ShowExceptions()
+    {
+        if (m_excp.Present())
+            m_excp.Show();
+    }
+
+    template < typename ... Args >
+    DataPtrType Make(Args&& ... args)
+    {
+        if constexpr (ValueItems)
+            return DataType(std::forward < Args >(args) ...);
+        else
+            return m_allocator.Make(std::forward < Args >(args) ...);
+    }
+
+    // Perform, Emplace and PerformBatch report whether the items were queued. Only
+    // bounded queues refuse items: Block waits for a free slot unless the policy
+    // stops, the other modes never wait.
+    template < typename ... Args >
+    bool Emplace(Args&& ... args)
+    {
+        Intake intake(*this);
+        if (!intake) return false;
+
+        try
+        {
+            if constexpr (BoundedQueue)
+                return Offer(Make(std::forward < Args >(args) ...), DefaultTimeout);
+            else if constexpr (ValueItems)
+                EmplaceAtomically(std::forward < Args >(args) ...);
+            else
+                EnqueueAtomically(Make(std::forward < Args >(args) ...));
+
+            SignalQueued(1);
+            return true;
+        }
+        catch (std::exception &)
+        {
+            m_excp.Add(std::current_exception());
+        }
+
+        return false;
+    }
+
+    bool Perform (const DataPtrType& dataPtr)
+    {
+        return Admit(dataPtr, DefaultTimeout);
+    }
+
+    bool Perform (DataPtrType&& dataPtr)
+    {
+        return Admit(std::move(dataPtr), DefaultTimeout);
+    }
+
+    // Never waits for a free slot.
+    bool TryPerform (const DataPtrType& dataPtr)
+    {
+        return Admit(dataPtr, 0);
+    }
+
+    bool TryPerform (DataPtrType&& dataPtr)
+    {
+        return Admit(std::move(dataPtr), 0);
+    }
+
+    // In Block and FailFast mode, waits for a free slot up to the timeout, so
+    // FailFast fails only once it passed; DropLowest and DropNew never wait and
+    // ignore it. Timeouts beyond the nanosecond range wait like Block's Perform.
+    template < typename Rep, typename Period >
+    bool PerformFor (const DataPtrType& dataPtr, std::chrono::duration < Rep, Period > timeout)
+    {
+        return Admit(dataPtr, TimeoutNs(timeout));
+    }
+
+    template < typename Rep, typename Period >
+    bool PerformFor (DataPtrType&& dataPtr, std::chrono::duration < Rep, Period > timeout)
+    {
+        return Admit(std::move(dataPtr), TimeoutNs(timeout));
+    }
+
+    // Queues the item like Perform and returns a handle to its result, which is
+    // what the callback returns. The handle is invalid when the item was refused
+    // or all completion slots are taken, and must not outlive the policy.
+    CompletionType Submit(DataPtrType dataPtr)
+    {
+        static_assert(Completes, "Submit needs Completable< Data, ResultType > items.");
+
+        CompletionSlot < CompletionResultType >* slot = m_completions.Acquire();
+        if (!slot) return CompletionType();
+
+        ItemRef(dataPtr).AttachCompletion(slot);
+        CompletionType completion(slot);
+        if (Admit(std::move(dataPtr), DefaultTimeout)) return completion;
+
+        bool present = true;
+        if constexpr (!ValueItems) present = static_cast < bool >(dataPtr);
+
+        if (present && ItemRef(dataPtr).DetachCompletion()) slot->Abandon();
+        return CompletionType();
+    }
+
+    // Returns how many items were queued.
+    template < typename IteratorType >
+    int PerformBatch(IteratorType first, IteratorType last)
+    {
+        Intake intake(*this);
+        if (!intake) return 0;
+
+        try
+        {
+            if constexpr (BoundedQueue)
+            {
+                int count = 0;
+                for (; first != last; ++first)
+                    count += Offer(*first, DefaultTimeout) ? 1 : 0;
+
+                return count;
+            }
+            else
+            {
+                int count = EnqueueAtomically(first, last);
+                if (count) SignalQueued(count);
+                return count;
+            }
+        }
+        catch (std::exception &)
+        {
+            m_excp.Add(std::current_exception());
+        }
+
+        return 0;
+    }
+
+    template < typename RangeType >
+    int PerformBatch(RangeType&& range)
+    {
+        return PerformBatch(std::begin(range), std::end(range));
+    }
+
+    // Data-parallel loops on the policy's workers. The calling thread takes part
+    // and returns once every index was processed, rethrowing the first exception;
+    // ranges up to grain indices run on the caller alone. Idle workers are woken
+    // to help and queued items still go first for workers already busy. A worker
+    // calling these keeps running queued items while it waits for helpers.
+
+    // Calls fn(i) for every i in [first, last).
+    template < typename IndexType, typename FunType >
+    void ParallelFor(IndexType first, IndexType last, FunType&& fn, size_t grain = ParallelJob::DefaultGrain)
+    {
+        if (!(first < last)) return;
+
+        auto body = [first, &fn](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+                fn(static_cast < IndexType >(first + static_cast < IndexType >(i)));
+        };
+        RunParallel(static_cast < size_t >(last - first), grain, body);
+    }
+
+    // std::transform over random access iterators; returns the end of the output.
+    template < typename InputIteratorType, typename OutputIteratorType, typename FunType >
+    OutputIteratorType ParallelTransform(InputIteratorType first, InputIteratorType last, OutputIteratorType out,
+        FunType&& fn, size_t grain = ParallelJob::DefaultGrain)
+    {
+        size_t size = static_cast < size_t >(std::distance(first, last));
+
+        auto body = [first, out, &fn](size_t begin, size_t end)
+        {
+            std::transform(first + begin, first + end, out + begin, fn);
+        };
+        RunParallel(size, grain, body);
+
+        return out + size;
+    }
+
+    // Like std::reduce, op must be associative and commutative: partial results
+    // of the chunks are combined in whatever order they finish.
+    template < typename InputIteratorType, typename ValueType, typename OpType >
+    ValueType ParallelReduce(InputIteratorType first, InputIteratorType last, ValueType init, OpType&& op,
+        size_t grain = ParallelJob::DefaultGrain)
+    {
+        std::optional < ValueType > total;
+        std::mutex lock;
+
+        auto body = [first, &op, &total, &lock](size_t begin, size_t end)
+        {
+            ValueType partial = std::accumulate(first + begin + 1, first + end, ValueType(first[begin]), op);
+
+            std::unique_lock < std::mutex > lk(lock);
+            total = total ? op(std::move(*total), std::move(partial)) : std::move(partial);
+        };
+        RunParallel(static_cast < size_t >(std::distance(first, last)), grain, body);
+
+        return total ? op(std::move(init), std::move(*total)) : init;
+    }
+
+    // Items discarded by the DropLowest and DropNew overflow modes.
+    unsigned long Dropped() const
+    {
+        return m_dropped.load(std::memory_order_relaxed);
+    }
+
+    // Refuses new items and lets the workers leave without draining the queue.
+    // Does not join the workers; it logs and may lock, so it is not signal-safe.
+    void Stop()
+    {
+        LogDebug("Stopping policy.");
+        Close(ShutdownOptions::Abort(), MonotonicNs());
+
+        m_sync.Stop();
+        m_space.Stop();
+    }
+
+    // Refuses new items, lets the workers finish as the options say and joins them;
+    // whatever is still queued then is handed back. Callbacks already running are
+    // waited for, so DrainUntil returns within the timeout plus the longest callback.
+    // Items submitted while Shutdown runs are processed, handed back or refused.
+    ShutdownReport < DataPtrType > Shutdown(const ShutdownOptions& options = ShutdownOptions())
+    {
+        long long start = MonotonicNs();
+
+        if (!Close(options, start))
+        {
+            while (!m_closing.load())
+                std::this_thread::yield();
+        }
+
+        m_space.Stop();
+        while (m_submitting.load())
+            std::this_thread::yield();
+
+        LogDebug("Shutting down policy.");
+        m_sync.Stop();
+        m_thread_pool.Join();
+
+        ShutdownReport < DataPtrType > report { m_drained.load(std::memory_order_relaxed), std::chrono::nanoseconds(0), {} };
+        {
+            LockerType < QueueLockType > l(m_lock);
+            for (ResultType item = m_queue.Dequeue(); item; item = m_queue.Dequeue())
+            {
+                if constexpr (ClassedQueue)
+                    m_queue.Finished(m_queue.ClassOf(PeekItem(item)));
+                report.leftovers.push_back(TakeItem(item));
+            }
+        }
+
+        report.elapsed = std::chrono::nanoseconds(MonotonicNs() - start);
+        return report;
+    }
+
+    PoolStatus Workers() const
+    {
+        return PoolStatus
+        {
+            m_pool_state.workers.load(std::memory_order_relaxed),
+            m_pool_state.idle.load(std::memory_order_relaxed),
+            m_pool_state.pending.load(std::memory_order_relaxed),
+            m_pool_state.grown.load(std::memory_order_relaxed),
+            m_pool_state.retired.load(std::memory_order_relaxed)
+        };
+    }
+
+    // Merged view of the per-thread measurements, taken while the workers run.
+    typename InstrumentationType::SnapshotType Snapshot() const
+    {
+        return m_instrumentation.Snapshot();
+    }
+
+    // For counters a queue keeps itself, such as BasicDeadlineQueue::Deadlines;
+    // the queue must not be used otherwise.
+    const QueueType< DataType >& Queue() const
+    {
+        return m_queue;
+    }
+
+protected:
+    // Only the first of Stop and Shutdown decides how the workers finish. The
+    // winner writes the options before publishing m_closing, and workers read
+    // them only after seeing it set, so the options are never written while read.
+    bool Close(const ShutdownOptions& options, long long start)
+    {
+        bool claimed = false;
+        if (!m_close_claimed.compare_exchange_strong(claimed, true)) return false;
+
+        m_shutdown = options;
+        if (options.timeout.count() < std::numeric_limits < long long >::max() - start)
+            m_drain_deadline = start + options.timeout.count();
+
+        m_closing.store(true, std::memory_order_release);
+        return true;
+    }
+
+    void ThreadPoolCallback()
+    {
+        Worker() = this;
+
+        try
+        {
+            LogDebug("Thread ", ThreadPoolType::GetCurrentThreadId(), " started.");
+
+            if (m_batch_callback)
+                ProcessBatches();
+            else
+                ProcessItems();
+
+            // A retired worker gave its index up, so it leaves draining to the others.
+            if (Worker() == this)
+                Drain();
+
+            LogDebug("Thread ", ThreadPoolType::GetCurrentThreadId(), " finished.");
+        }
+        catch (std::exception &)
+        {
+            m_excp.Add(std::current_exception ());
+        }
+    }
+
+    void ProcessItems()
+    {
+        while (AwaitItem())
+        {
+            m_board.Help();
+
+            ResultType item = DequeueAtomically();
+            if (!item) continue;
+
+            OnDequeued(1);
+            Dispatch(item);
+            Regrow();
+        }
+    }
+
+    void ProcessBatches()
+    {
+        std::vector < DataPtrType > batch;
+        batch.reserve(m_batch_size);
+
+        while (AwaitItem())
+        {
+            m_board.Help();
+
+            // One token is ours already; grab as many more as are pending, up to the batch size.
+            int count = 1 + m_sync.TryAcquire(m_batch_size - 1);
+
+            DequeueAtomically(count, batch);
+            if (batch.empty()) continue;
+
+            OnDequeued(static_cast < int >(batch.size()));
+            DispatchBatch(batch);
+            Regrow();
+        }
+    }
+
+    void Dispatch(ResultType& item)
+    {
+        m_instrumentation.OnDequeue(PeekItem(item));
+        if constexpr (DispatchAware)
+            m_queue.Dispatched(PeekItem(item));
+        typename InstrumentationType::Probe probe = m_instrumentation.Begin(PeekItem(item));
+
+        m_space.Signal();
+        ClassRelease release(*this, PeekItem(item));
+        CallbackClock clock(m_pool_state);
+        if constexpr (Completes)
+            Complete(ItemRef(item).DetachCompletion(), item);
+        else
+            m_callback(TakeItem(item));
+        m_instrumentation.End(probe);
+    }
+
+    // A callback exception goes to the item's handle instead of ending the worker;
+    // items queued with Perform carry no slot and behave as before.
+    void Complete(CompletionSlot < CompletionResultType >* slot, ResultType& item)
+    {
+        if (!slot)
+        {
+            m_callback(TakeItem(item));
+            return;
+        }
+
+        try
+        {
+            if constexpr (std::is_void < CompletionResultType >::value)
+            {
+                m_callback(TakeItem(item));
+                slot->Complete();
+            }
+            else
+                slot->Complete(m_callback(TakeItem(item)));
+        }
+        catch (...)
+        {
+            slot->Fail(std::current_exception());
+        }
+    }
+
+    void DispatchBatch(std::vector < DataPtrType >& batch)
+    {
+        for (const DataPtrType& item : batch)
+        {
+            m_instrumentation.OnDequeue(item);
+            if constexpr (DispatchAware)
+                m_queue.Dispatched(item);
+        }
+
+        m_space.Signal(static_cast < int >(batch.size()));
+
+        // A batch is timed as a whole, under its first and most urgent item.
+        typename InstrumentationType::Probe probe = m_instrumentation.Begin(batch.front());
+        CallbackClock clock(m_pool_state);
+
+        if constexpr (ClassedQueue)
+        {
+            std::vector < int > classes;
+            for (const DataPtrType& item : batch)
+                classes.push_back(m_queue.ClassOf(item));
+
+            try
+            {
+                RunBatch(batch);
+            }
+            catch (...)
+            {
+                for (int c : classes)
+                    ReleaseClass(c);
+                throw;
+            }
+
+            for (int c : classes)
+                ReleaseClass(c);
+        }
+        else
+            RunBatch(batch);
+
+        m_instrumentation.End(probe, static_cast < int >(batch.size()));
+        batch.clear();
+    }
+
+    void RunBatch(std::vector < DataPtrType >& batch)
+    {
+        if constexpr (Completes)
+        {
+            try
+            {
+                m_batch_callback(ItemSpan < DataPtrType >(batch.data(), batch.size()));
+            }
+            catch (...)
+            {
+                if (!CompleteBatch(batch, std::current_exception())) throw;
+            }
+
+            CompleteBatch(batch, nullptr);
+        }
+        else
+            m_batch_callback(ItemSpan < DataPtrType >(batch.data(), batch.size()));
+    }
+
+    // A batch callback has no per-item results: slots it left attached complete
+    // without a value, or are abandoned when a value is expected. A callback
+    // producing results detaches and completes the slots itself.
+    bool CompleteBatch(std::vector < DataPtrType >& batch, std::exception_ptr error)
+    {
+        bool any = false;
+        for (DataPtrType& item : batch)
+        {
+            if constexpr (!ValueItems)
+                if (!item) continue;
+
+            CompletionSlot < CompletionResultType >* slot = ItemRef(item).DetachCompletion();
+            if (!slot) continue;
+
+            any = true;
+            if (error)
+                slot->Fail(error);
+            else if constexpr (std::is_void < CompletionResultType >::value)
+                slot->Complete();
+            else
+                slot->Abandon();
+        }
+
+        return any;
+    }
+
+    // Once Shutdown stopped the loop, the worker keeps taking items without
+    // waiting for tokens, until DrainNext says to stop.
+    void Drain()
+    {
+        if (!m_closing.load(std::memory_order_acquire) || m_shutdown.mode == ShutdownMode::Abort) return;
+
+        std::vector < DataPtrType > batch;
+        for (bool more = true; more;)
+        {
+            ResultType item = DrainNext();
+            more = static_cast < bool >(item);
+
+            if (more)
+            {
+                m_drained.fetch_add(1, std::memory_order_relaxed);
+                OnDequeued(1);
+
+                if (!m_batch_callback)
+                {
+                    Dispatch(item);
+                    continue;
+                }
+
+                batch.push_back(TakeItem(item));
+            }
+
+            if (!batch.empty() && (!more || static_cast < int >(batch.size()) >= m_batch_size))
+                DispatchBatch(batch);
+        }
+    }
+
+    // An item below the DrainAbove floor goes back to the queue and ends this
+    // worker's drain; queues without a strict order may still hold higher ones.
+    // The item is put back under the same lock, so a queue that can keeps its key.
+    ResultType DrainNext()
+    {
+        if (m_shutdown.mode == ShutdownMode::DrainUntil && MonotonicNs() >= m_drain_deadline)
+            return ResultType();
+
+        LockerType < QueueLockType > l(m_lock);
+        ResultType item = m_queue.Dequeue();
+        if (item && m_shutdown.mode == ShutdownMode::DrainAbove && ItemRef(PeekItem(item)).GetPriority() < m_shutdown.minPriority)
+        {
+            if constexpr (ClassedQueue)
+                m_queue.Finished(m_queue.ClassOf(PeekItem(item)));
+            if constexpr (IsRequeueable< QueueType< DataType > >::value)
+                m_queue.Requeue(TakeItem(item));
+            else
+                m_queue.Enqueue(TakeItem(item));
+            return ResultType();
+        }
+
+        return item;
+    }
+
+    template < typename ItemType >
+    bool Admit(ItemType&& dataPtr, long long timeoutNs)
+    {
+        Intake intake(*this);
+        if (!intake) return false;
+
+        try
+        {
+            if constexpr (BoundedQueue)
+                return Offer(std::forward < ItemType >(dataPtr), timeoutNs);
+            else
+            {
+                EnqueueAtomically(std::forward < ItemType >(dataPtr));
+                SignalQueued(1);
+                return true;
+            }
+        }
+        catch (std::exception &)
+        {
+            m_excp.Add(std::current_exception());
+        }
+
+        return false;
+    }
+
+    template < typename ItemType >
+    bool Offer(ItemType&& dataPtr, long long timeoutNs)
+    {
+        if constexpr (CountsSlots)
+        {
+            if (!AcquireSlot(timeoutNs)) return false;
+
+            EnqueueAtomically(std::forward < ItemType >(dataPtr));
+            SignalQueued(1);
+            return true;
+        }
+        else
+        {
+            bool accepted = true;
+            bool grown = true;
+
+            m_instrumentation.Stamp(dataPtr);
+            {
+                LockerType < QueueLockType > l(m_lock);
+                if (m_queue.Full())
+                {
+                    grown = false;
+                    if (OverflowMode == Overflow::DropNew || ItemRef(dataPtr).GetPriority() <= m_queue.LowestPriority())
+                        accepted = false;
+                    else
+                        m_queue.DropLowest();
+                }
+
+                if (accepted) m_queue.Enqueue(std::forward < ItemType >(dataPtr));
+            }
+
+            if (grown)
+            {
+                m_instrumentation.OnEnqueue(1);
+                SignalQueued(1);
+            }
+            else
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+
+            return accepted;
+        }
+    }
+
+    // Gives the item's class slot back once its callback returned, also when it threw.
+    class ClassRelease
+    {
+        AsyncWorkPolicy& m_policy;
+        int m_class;
+    public:
+        ClassRelease(AsyncWorkPolicy& policy, const DataPtrType& item)
+        : m_policy(policy)
+        , m_class(0)
+        {
+            if constexpr (ClassedQueue)
+                m_class = m_policy.m_queue.ClassOf(item);
+            else
+                (void)item;
+        }
+
+        ~ClassRelease()
+        {
+            if constexpr (ClassedQueue)
+                m_policy.ReleaseClass(m_class);
+        }
+    };
+
+    // Counts whether a callback in an elastic pool spent less than half its wall
+    // time on a CPU. Reading the thread's CPU clock is a system call, so only one
+    // callback in ClockEvery per worker is timed. Counting callbacks rather than
+    // adding up times keeps a few preempted ones from passing for blocking.
+    class CallbackClock
+    {
+        static constexpr unsigned int ClockEvery = 16;
+
+        PoolState& m_state;
+        long long m_wall;
+        long long m_cpu;
+    public:
+        CallbackClock(PoolState& state)
+        : m_state(state)
+        , m_wall(0)
+        , m_cpu(-1)
+        {
+            if constexpr (ElasticPool)
+            {
+                static thread_local unsigned int s_tick = 0;
+                if (s_tick++ % ClockEvery) return;
 
-    Exceptioning m_excp;
-    QueueType< DataType > m_queue;
-    CallbackType m_callback;
-    LockType m_lock;
-    SyncType m_sync;
-    ThreadPoolType m_thread_pool;
-public:
-    AsyncWorkPolicy(CallbackType&& callback)
-    : m_callback(callback)
-    , m_sync(ThreadNumber::Get())
-    , m_thread_pool(ThreadNumber::Get(), std::bind(&AsyncWorkPolicy::ThreadPoolCallback, this))
+                m_wall = MonotonicNs();
+                m_cpu = ThreadCpuNs();
+            }
+        }
+
+        ~CallbackClock()
+        {
+            if constexpr (ElasticPool)
+            {
+                if (m_cpu < 0) return;
+
+                long long wall = MonotonicNs() - m_wall;
+                long long cpu = ThreadCpuNs() - m_cpu;
+                m_state.timed.fetch_add(1, std::memory_order_relaxed);
+                if (cpu * 2 < wall)
+                    m_state.waited.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    void ReleaseClass(int c)
     {
-        try
+        bool wake;
         {
-            m_thread_pool.Start();
-            std::cout << "Starting policy." << std::endl;
+            LockerType < QueueLockType > l(m_lock);
+            wake = m_queue.Finished(c);
         }
-        catch (std::exception &)
+
+        if (wake) m_sync.Signal();
+    }
+
+    // Producers inside Emplace, Perform or PerformBatch; Shutdown waits for them
+    // after closing, so no item is queued behind its back.
+    class Intake
+    {
+        AsyncWorkPolicy& m_policy;
+        bool m_open;
+    public:
+        Intake(AsyncWorkPolicy& policy)
+        : m_policy(policy)
         {
-            m_excp.Add(std::current_exception());
+            m_policy.m_submitting.fetch_add(1);
+            m_open = !m_policy.m_closing.load();
+        }
+
+        ~Intake()
+        {
+            m_policy.m_submitting.fetch_sub(1, std::memory_order_release);
+        }
+
+        explicit operator bool() const
+        {
+            return m_open;
         }
+    };
+
+    // The policy whose worker the current thread is, if any.
+    static const AsyncWorkPolicy*& Worker()
+    {
+        static thread_local const AsyncWorkPolicy* s_policy = nullptr;
+        return s_policy;
     }
 
-    ~AsyncWorkPolicy()
+    template < typename BodyType >
+    static void RunChunk(void* body, size_t begin, size_t end)
     {
-        Stop();
+        (*static_cast < BodyType* >(body))(begin, end);
     }
 
-    void ShowExceptions()
+    // Wakes one worker per chunk beyond the caller's, at most all of them; the
+    // extra tokens only make woken workers find the queue empty. An empty range
+    // returns before publishing anything.
+    template < typename BodyType >
+    void RunParallel(size_t size, size_t grain, BodyType& body)
     {
-        if (m_excp.Present())
-            m_excp.Show();
+        if (!size) return;
+
+        size_t chunks = (size - 1) / std::max < size_t >(grain, 1);
+        int helpers = static_cast < int >(std::min < size_t >(chunks,
+            static_cast < size_t >(m_pool_state.workers.load(std::memory_order_relaxed))));
+
+        ParallelJob job(size, grain, helpers + 1, &RunChunk < BodyType >, &body);
+        int slot = (helpers && !m_closing.load()) ? m_board.Publish(&job) : -1;
+        if (slot >= 0)
+            m_sync.Signal(helpers);
+
+        job.Help();
+        if (slot >= 0)
+            JoinParallel(slot);
+
+        job.Rethrow();
     }
 
-    void Perform (const typename QueueType< DataType >::DataPtrType& dataPtr)
+    // Every chunk is claimed by now; waits for helpers still running one. Workers
+    // help other loops and run queued items meanwhile instead of sleeping.
+    void JoinParallel(int slot)
     {
-        try
+        m_board.Withdraw(slot);
+
+        bool worker = Worker() == this;
+        for (int spin = 0; m_board.Busy(slot); ++spin)
+        {
+            if (m_board.Help() || (worker && HelpQueued())) continue;
+
+            if (worker || spin < 64)
+                std::this_thread::yield();
+            else
+                m_board.Wait(slot);
+        }
+
+        m_board.Release(slot);
+    }
+
+    bool HelpQueued()
+    {
+        if (m_batch_callback || !m_sync.TryAcquire(1)) return false;
+
+        ResultType item = DequeueAtomically();
+        if (item)
+        {
+            OnDequeued(1);
+            Dispatch(item);
+        }
+
+        return true;
+    }
+
+    // False once the worker is to leave: the policy stopped, or the worker idled
+    // out of an elastic pool.
+    bool AwaitItem()
+    {
+        if constexpr (!ElasticPool)
+            return !m_sync.Wait();
+        else
         {
-            EnqueueAtomically(dataPtr);
+            for (;;)
+            {
+                m_pool_state.idle.fetch_add(1, std::memory_order_relaxed);
+                WaitResult result = m_sync.WaitFor(ThreadNumber::Idle());
+                m_pool_state.idle.fetch_sub(1, std::memory_order_relaxed);
+
+                if (result != WaitResult::Timeout) return result == WaitResult::Acquired;
+                if (Retire()) return false;
+            }
+        }
+    }
+
+    void SignalQueued(int count)
+    {
+        if (count == 1)
             m_sync.Signal();
+        else
+            m_sync.Signal(count);
+
+        if constexpr (ElasticPool)
+            Grow(count);
+    }
+
+    void OnDequeued(int count)
+    {
+        if constexpr (ElasticPool)
+        {
+            m_pool_state.pending.fetch_sub(count, std::memory_order_relaxed);
+            m_pool_state.lastDequeue.store(MonotonicNs(), std::memory_order_relaxed);
+        }
+    }
+
+    // Workers look again after each callback, since a burst may be queued before
+    // any callback showed that it blocks.
+    void Regrow()
+    {
+        if constexpr (ElasticPool)
+        {
+            if (!m_closing.load(std::memory_order_relaxed))
+                Grow(0);
+        }
+    }
+
+    void Grow(int count)
+    {
+        long pending = count ?
+            m_pool_state.pending.fetch_add(count, std::memory_order_relaxed) + count :
+            m_pool_state.pending.load(std::memory_order_relaxed);
+
+        int workers = m_pool_state.workers.load(std::memory_order_relaxed);
+        if (workers >= ThreadNumber::Max()) return;
+
+        // Past one worker per core a new worker only helps callbacks that wait.
+        if (workers >= ThreadNumber::Cores() && !CallbacksBlock()) return;
+
+        bool deep = pending > static_cast < long >(workers) * ThreadNumber::Depth();
+        if (!deep)
+        {
+            if (m_pool_state.idle.load(std::memory_order_relaxed)) return;
+
+            long long stalledNs = MonotonicNs() - m_pool_state.lastDequeue.load(std::memory_order_relaxed);
+            if (stalledNs <= ThreadNumber::Stall().count()) return;
+        }
+
+        if (!m_pool_state.workers.compare_exchange_strong(workers, workers + 1, std::memory_order_relaxed)) return;
+
+        try
+        {
+            m_thread_pool.AddWorker();
         }
         catch (std::exception &)
         {
+            m_pool_state.workers.fetch_sub(1, std::memory_order_relaxed);
             m_excp.Add(std::current_exception());
+            return;
         }
+
+        m_pool_state.grown.fetch_add(1, std::memory_order_relaxed);
+        LogDebug("Pool grown to ", workers + 1, " workers.");
     }
 
-    void Stop()
+    // Looks at the timed callbacks at most once per stall interval; when most of
+    // them waited, more workers than cores help.
+    bool CallbacksBlock()
     {
-        std::cout << "Stopping policy." << std::endl;
-        m_sync.Stop();
+        long long now = MonotonicNs();
+        long long last = m_pool_state.sampledAt.load(std::memory_order_relaxed);
+        if (now - last >= ThreadNumber::Stall().count() &&
+            m_pool_state.sampledAt.compare_exchange_strong(last, now, std::memory_order_relaxed))
+        {
+            long timed = m_pool_state.timed.exchange(0, std::memory_order_relaxed);
+            long waited = m_pool_state.waited.exchange(0, std::memory_order_relaxed);
+            if (timed > 0)
+                m_pool_state.blocking.store(waited * 2 > timed, std::memory_order_relaxed);
+        }
+
+        return m_pool_state.blocking.load(std::memory_order_relaxed);
     }
 
-protected:
-    void ThreadPoolCallback()
+    // Decided under the pool's lock, which also frees the worker's index, so a
+    // Grow that saw the lower count starts its worker on that index again and
+    // indices stay below Max.
+    bool Retire()
     {
-        try
+        bool retired = m_thread_pool.RetireWorker([this]()
         {
-            std::cout << "Thread " << ThreadPoolType::GetCurrentThreadId() << " started." << std::endl;
-
-            for (;;)
+            int workers = m_pool_state.workers.load(std::memory_order_relaxed);
+            while (workers > ThreadNumber::Get())
             {
-                bool stop = m_sync.Wait();
-                if (stop) break;
-
-                typename QueueType< DataType >::DataPtrType dataPtr = DequeueAtomically();
-                if (!dataPtr) continue;
-                
-                m_callback(dataPtr);
+                if (m_pool_state.workers.compare_exchange_weak(workers, workers - 1, std::memory_order_relaxed))
+                {
+                    m_pool_state.retired.fetch_add(1, std::memory_order_relaxed);
+                    LogDebug("Pool shrunk to ", workers - 1, " workers.");
+                    return true;
+                }
             }
 
-            std::cout << "Thread " << ThreadPoolType::GetCurrentThreadId() << " finished." << std::endl;
+            return false;
+        });
+
+        if (retired)
+            Worker() = nullptr;
+
+        return retired;
+    }
+
+    template < typename Rep, typename Period >
+    static long long TimeoutNs(std::chrono::duration < Rep, Period > timeout)
+    {
+        // Compared in floating point, as the cast itself overflows for long durations.
+        std::chrono::duration < double, std::nano > ns = timeout;
+        if (ns.count() >= static_cast < double >(std::chrono::nanoseconds::max().count())) return WaitForever;
+        return std::max < long long >(std::chrono::duration_cast < std::chrono::nanoseconds >(timeout).count(), 0);
+    }
+
+    bool AcquireSlot(long long timeoutNs)
+    {
+        if (timeoutNs < 0) return !m_space.Wait();
+        if (!timeoutNs) return m_space.TryAcquire(1) == 1;
+
+        return m_space.WaitFor(std::chrono::nanoseconds(timeoutNs)) == WaitResult::Acquired;
+    }
+
+    void EnqueueAtomically(const DataPtrType& dataPtr)
+    {
+        m_instrumentation.Stamp(dataPtr);
+        {
+            LockerType < QueueLockType > l(m_lock);
+            m_queue.Enqueue(dataPtr);
         }
-        catch (std::exception &)
+        m_instrumentation.OnEnqueue(1);
+    }
+
+    void EnqueueAtomically(DataPtrType&& dataPtr)
+    {
+        m_instrumentation.Stamp(dataPtr);
         {
-            m_excp.Add(std::current_exception ());
+            LockerType < QueueLockType > l(m_lock);
+            m_queue.Enqueue(std::move(dataPtr));
+        }
+        m_instrumentation.OnEnqueue(1);
+    }
+
+    template < typename ... Args >
+    void EmplaceAtomically(Args&& ... args)
+    {
+        {
+            LockerType < QueueLockType > l(m_lock);
+            m_queue.Emplace(std::forward < Args >(args) ...);
         }
+        m_instrumentation.OnEnqueue(1);
     }
 
-    void EnqueueAtomically(const typename QueueType< DataType >::DataPtrType& dataPtr)
+    template < typename IteratorType >
+    int EnqueueAtomically(IteratorType first, IteratorType last)
     {
-        LockerType < LockType > l(m_lock);
-        m_queue.Enqueue(dataPtr);
+        int count = 0;
+        {
+            LockerType < QueueLockType > l(m_lock);
+            for (; first != last; ++first, ++count)
+            {
+                m_instrumentation.Stamp(*first);
+                m_queue.Enqueue(*first);
+            }
+        }
+        m_instrumentation.OnEnqueue(count);
+
+        return count;
     }
 
-    typename QueueType< DataType >::DataPtrType DequeueAtomically()
+    ResultType DequeueAtomically()
     {
-        LockerType < LockType > l(m_lock);
+        LockerType < QueueLockType > l(m_lock);
         return m_queue.Dequeue();
     }
+
+    void DequeueAtomically(int count, std::vector < DataPtrType >& batch)
+    {
+        LockerType < QueueLockType > l(m_lock);
+        for (int i = 0; i < count; ++i)
+        {
+            ResultType item = m_queue.Dequeue();
+            if (item)
+                batch.push_back(TakeItem(item));
+            else if constexpr (!ClassedQueue)
+                break;
+
+            // A classed queue holds back one token per refused Dequeue and
+            // signals it again from Finished, so every token is offered.
+        }
+    }
+
+    template < typename ItemType >
+    static ItemType&& TakeItem(std::optional < ItemType >& item)
+    {
+        return std::move(*item);
+    }
+
+    template < typename ItemType >
+    static ItemType&& TakeItem(ItemType& item)
+    {
+        return std::move(item);
+    }
+
+    template < typename ItemType >
+    static const ItemType& PeekItem(const std::optional < ItemType >& item)
+    {
+        return *item;
+    }
+
+    template < typename ItemType >
+    static const ItemType& PeekItem(const ItemType& item)
+    {
+        return item;
+    }
+
+private:
+    // Synchronizers and instrumentation are sized for the largest pool.
+    static int MaxWorkers()
+    {
+        if constexpr (ElasticPool)
+            return ThreadNumber::Max();
+        else
+            return ThreadNumber::Get();
+    }
+
+    static QueueType< DataType > CreateQueue()
+    {
+        if constexpr (std::is_constructible < QueueType< DataType >, int >::value)
+            return QueueType< DataType >(MaxWorkers());
+        else
+            return QueueType< DataType >();
+    }
 };
 
 class Data
@@ -184,56 +1546,84 @@ class Data
 public:
     Data(int a, int b, int p = 10):m_a (a), m_b (b), m_p (p) {}
 
-    int GetPriority() { return m_p; }
+    int GetPriority() const { return m_p; }
 
-    std::string Printout()
+    std::string Printout() const
     {
         std::stringstream sstm;
-        sstm << "{ a: " << m_a << ", b: " << m_b << ", priority: " << m_p << " }." << std::endl;
+        sstm << "{ a: " << m_a << ", b: " << m_b << ", priority: " << m_p << " }.";
         return sstm.str ();
     }
 };
 
-template < typename DataType > class PriorityQueue
+// Binary heap kept in a vector, so items can be moved out on Dequeue and a
+// warmed-up queue does not allocate. ItemType is either a nullable pointer-like
+// handle or DataType itself, in which case Dequeue returns std::optional.
+template < typename DataType, typename ItemType > class BasicPriorityQueue
 {
 public:
-    using DataPtrType = std::shared_ptr < DataType >;
+    using DataPtrType = ItemType;
+    using ResultType = std::conditional_t
+    <
+        IsItemHandle < ItemType >::value,
+        ItemType,
+        std::optional < ItemType >
+    >;
     
     struct Comparator
     {
         bool operator()(const DataPtrType& lhs, const DataPtrType& rhs) const
         {
-            assert(lhs && rhs);
-            return (lhs->GetPriority () < rhs->GetPriority ());
+            if constexpr (IsItemHandle < DataPtrType >::value)
+                assert(lhs && rhs);
+            return (ItemRef(lhs).GetPriority () < ItemRef(rhs).GetPriority ());
         }
     };
 
     void Enqueue(const DataPtrType & d)
     {
-        std::cout << "Enqueue entry - " << d->Printout () << std::endl;
-        m_q.push (d);
+        LogTrace("Enqueue entry - ", ItemRef(d));
+        m_q.push_back (d);
+        std::push_heap (std::begin(m_q), std::end(m_q), Comparator());
     }
 
-    DataPtrType Dequeue ()
+    void Enqueue(DataPtrType && d)
     {
-        if (m_q.empty ()) return DataPtrType();
-        DataPtrType d = m_q.top ();
-        m_q.pop ();
+        LogTrace("Enqueue entry - ", ItemRef(d));
+        m_q.push_back (std::move(d));
+        std::push_heap (std::begin(m_q), std::end(m_q), Comparator());
+    }
+
+    template < typename ... Args >
+    void Emplace(Args && ... args)
+    {
+        m_q.emplace_back (std::forward < Args >(args) ...);
+        LogTrace("Enqueue entry - ", ItemRef(m_q.back ()));
+        std::push_heap (std::begin(m_q), std::end(m_q), Comparator());
+    }
 
-        std::cout << "Dequeue entry - " << d->Printout () << std::endl;
+    ResultType Dequeue ()
+    {
+        if (m_q.empty ()) return ResultType();
+        std::pop_heap (std::begin(m_q), std::end(m_q), Comparator());
+        ResultType d(std::move(m_q.back ()));
+        m_q.pop_back ();
+
+        LogTrace("Dequeue entry - ", ItemRef(d));
         
         return d;
     }
 
 private:
-    std::priority_queue 
-    <
-        DataPtrType,
-        std::deque < DataPtrType >,
-        typename PriorityQueue::Comparator
-    > m_q;
+    std::vector < DataPtrType > m_q;
 };
 
+template < typename DataType >
+using PriorityQueue = BasicPriorityQueue < DataType, std::shared_ptr < DataType > >;
+
+template < typename DataType >
+using ValuePriorityQueue = BasicPriorityQueue < DataType, DataType >;
+
 template < typename DerivedType > class GenericLock
 {
 public:
@@ -257,6 +1647,112 @@ protected:
     }
 };
 
+class NullLock : public GenericLock < NullLock >
+{
+public:
+    void Lock() {}
+    void Unlock() {}
+};
+
+inline void CpuRelax()
+{
+#if defined( __x86_64__ ) || defined( __i386__ ) || defined( _M_X64 )
+    _mm_pause();
+#elif defined( __aarch64__ )
+    asm volatile("yield" ::: "memory");
+#else
+    std::this_thread::yield();
+#endif
+}
+
+// Spins briefly, then yields between attempts, so contenders give a preempted
+// holder the CPU back instead of burning their own time slices.
+class SpinLock : public GenericLock < SpinLock >
+{
+    static constexpr int SpinLimit = 64;
+
+    std::atomic < bool > m_locked;
+public:
+    SpinLock() : m_locked(false) {}
+
+    bool TryLock()
+    {
+        return !m_locked.load(std::memory_order_relaxed) &&
+            !m_locked.exchange(true, std::memory_order_acquire);
+    }
+
+    void Lock()
+    {
+        for (int spin = 0; !TryLock();)
+        {
+            while (m_locked.load(std::memory_order_relaxed))
+            {
+                if (spin < SpinLimit)
+                {
+                    ++spin;
+                    CpuRelax();
+                }
+                else
+                    std::this_thread::yield();
+            }
+        }
+    }
+
+    void Unlock()
+    {
+        m_locked.store(false, std::memory_order_release);
+    }
+};
+
+// Cheap per-thread xorshift generator for randomized queue and victim selection.
+inline unsigned int FastRandom()
+{
+    static thread_local unsigned int s_state =
+        static_cast < unsigned int >(std::hash < std::thread::id >()(std::this_thread::get_id())) | 1u;
+    s_state ^= s_state << 13;
+    s_state ^= s_state >> 17;
+    s_state ^= s_state << 5;
+    return s_state;
+}
+
+inline int HighestSetBit(unsigned long long value)
+{
+    assert(value);
+#if defined( _MSC_VER )
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return static_cast < int >(index);
+#else
+    return 63 - __builtin_clzll(value);
+#endif
+}
+
+inline int LowestSetBit(unsigned long long value)
+{
+    assert(value);
+#if defined( _MSC_VER )
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return static_cast < int >(index);
+#else
+    return __builtin_ctzll(value);
+#endif
+}
+
+// Index of the pool worker running on the calling thread, -1 outside of a pool.
+class WorkerIndex
+{
+    static int& Current()
+    {
+        static thread_local int s_index = -1;
+        return s_index;
+    }
+
+public:
+    static int Get() { return Current(); }
+    static void Set(int index) { Current() = index; }
+};
+
 template < typename LockType > class ScopedLocker
 {
     LockType& m_lock;
@@ -269,7 +1765,10 @@ template < typename DerivedType > class GenericSync
 {
 public:
     void Signal() { Self().Signal(); }
+    void Signal(int count) { Self().Signal(count); }
     bool Wait() { return Self().Wait(); }
+    WaitResult WaitFor(std::chrono::nanoseconds timeout) { return Self().WaitFor(timeout); }
+    int TryAcquire(int max) { return Self().TryAcquire(max); }
     void Stop() { Self().Stop(); }
 
 protected:
@@ -279,6 +1778,130 @@ protected:
     }
 };
 
+// Stands in for a synchronizer the policy does not need, the way NullLock does for locks.
+class NullSync : public GenericSync < NullSync >
+{
+public:
+    template < typename ... Args >
+    NullSync(Args&& ...) {}
+
+    void Signal() {}
+    void Signal(int) {}
+    bool Wait() { return false; }
+    WaitResult WaitFor(std::chrono::nanoseconds) { return WaitResult::Acquired; }
+    int TryAcquire(int max) { return max; }
+    void Stop() {}
+};
+
+// Wait strategies decide what a synchronizer does before it parks a worker.
+// Spin() polls the given non-blocking acquire and reports whether it succeeded.
+class ParkWaitStrategy
+{
+public:
+    template < typename ... Args >
+    ParkWaitStrategy(Args&& ...) {}
+
+    void OnSignal() {}
+
+    template < typename AcquireType >
+    bool Spin(AcquireType&&) { return false; }
+};
+
+// Busy-spins with pause instructions, then yields, then gives up and lets the
+// synchronizer park. The budget follows a moving average of the time between
+// signals: twice the average gap, and nothing at all once the gap exceeds the
+// limit, so an idle pool goes straight to sleep. A spinning worker takes a CPU
+// the producers and running callbacks could use, so there is no spinning on a
+// single CPU or with more workers than CPUs, and at most one worker per CPU
+// but one spins at a time.
+template < unsigned int MaxSpinMicroseconds = 50 >
+class AdaptiveSpinWaitStrategy
+{
+    static constexpr long long MaxSpinNs = MaxSpinMicroseconds * 1000LL;
+    static constexpr long long MinSpinNs = 1000;
+
+    std::atomic < long long > m_last_signal;
+    std::atomic < long long > m_average_gap;
+    std::atomic < int > m_spinners;
+    int m_max_spinners;
+
+    static int MaxSpinners(int workers)
+    {
+        int cpus = static_cast < int >(std::thread::hardware_concurrency());
+        if (cpus <= 1 || workers > cpus) return 0;
+
+        return cpus - 1;
+    }
+
+public:
+    AdaptiveSpinWaitStrategy(int workers = 1)
+    : m_last_signal(0)
+    , m_average_gap(MaxSpinNs + 1)
+    , m_spinners(0)
+    , m_max_spinners(MaxSpinners(workers))
+    {}
+
+    void OnSignal()
+    {
+        long long now = MonotonicNs();
+        long long last = m_last_signal.exchange(now, std::memory_order_relaxed);
+        if (!last) return;
+
+        long long gap = m_average_gap.load(std::memory_order_relaxed);
+        m_average_gap.store(gap + (now - last - gap) / 8, std::memory_order_relaxed);
+    }
+
+    long long Budget() const
+    {
+        if (!m_max_spinners) return 0;
+
+        long long gap = m_average_gap.load(std::memory_order_relaxed);
+        if (gap > MaxSpinNs) return 0;
+
+        return std::min(std::max(2 * gap, MinSpinNs), MaxSpinNs);
+    }
+
+    template < typename AcquireType >
+    bool Spin(AcquireType&& acquire)
+    {
+        long long budget = Budget();
+        if (!budget) return false;
+
+        if (m_spinners.fetch_add(1, std::memory_order_relaxed) >= m_max_spinners)
+        {
+            m_spinners.fetch_sub(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        bool acquired = SpinFor(budget, acquire);
+        m_spinners.fetch_sub(1, std::memory_order_relaxed);
+        return acquired;
+    }
+
+private:
+    template < typename AcquireType >
+    static bool SpinFor(long long budget, AcquireType& acquire)
+    {
+        long long start = MonotonicNs();
+        long long now = start;
+        for (unsigned int i = 1; ; ++i)
+        {
+            if (acquire()) return true;
+
+            if (!(i % 16))
+            {
+                now = MonotonicNs();
+                if (now - start >= budget) return false;
+            }
+
+            if (now - start < budget / 2)
+                CpuRelax();
+            else
+                std::this_thread::yield();
+        }
+    }
+};
+
 template <typename DerivedType> class GenericThreadPool
 {
 public:
@@ -287,6 +1910,12 @@ public:
         Self().Start();
     }
 
+    // Waits for every worker to return; the pool can not be restarted.
+    void Join()
+    {
+        Self().Join();
+    }
+
     static unsigned int GetCurrentThreadId()
     {
         return DerivedType::GetCurrentThreadId();
@@ -0,0 +1,144 @@
+#if !defined( __SHARDED_PRIORITY_QUEUE_H__ )
+#define __SHARDED_PRIORITY_QUEUE_H__
+
+#include "HeapShard.h"
+#include "Topology.h"
+
+enum class ShardDistribution
+{
+    RoundRobin,
+    ProducerHash,
+    NumaNode
+};
+
+// One heap per worker. Outside producers spread items round-robin or by a hash of
+// their thread, workers submitting items keep them in their own shard. A worker
+// serves its own shard unless a random sibling has a better top, and once its own
+// shard runs dry it steals the best top among all siblings.
+// NumaNode keeps one shard per NUMA node instead and both producers and workers
+// use the shard of the node they run on, so an item allocated by a producer is
+// mostly processed by a worker of the same node. Its workers serve their own
+// node's shard first, whatever the other tops, and only steal from other nodes
+// once it runs dry.
+template < typename DataType, ShardDistribution Distribution >
+class BasicShardedPriorityQueue
+{
+public:
+    using DataPtrType = std::shared_ptr < DataType >;
+
+    static constexpr bool SelfSynchronized = true;
+
+    BasicShardedPriorityQueue(int threadNum)
+    : m_count(static_cast < unsigned int >(std::max(ShardCount(threadNum), 1)))
+    , m_shards(new Shard[m_count])
+    , m_next(0)
+    , m_size(0)
+    {}
+
+    void Enqueue(const DataPtrType& d)
+    {
+        Push(DataPtrType(d));
+    }
+
+    void Enqueue(DataPtrType&& d)
+    {
+        Push(std::move(d));
+    }
+
+    DataPtrType Dequeue()
+    {
+        if (!ReserveItem(m_size)) return DataPtrType();
+
+        Shard& own = m_shards[OwnIndex()];
+        DataPtrType d;
+
+        for (;;)
+        {
+            if constexpr (Distribution == ShardDistribution::NumaNode)
+            {
+                if (own.Pop(d)) return d;
+                if (Best().Pop(d)) return d;
+                continue;
+            }
+
+            Shard& sibling = m_shards[FastRandom() % m_count];
+            Shard& first = (sibling.Top() > own.Top()) ? sibling : own;
+            if (first.Pop(d)) return d;
+
+            if (Best().Pop(d)) return d;
+        }
+    }
+
+private:
+    using Shard = HeapShard < DataPtrType >;
+
+    static int ShardCount(int threadNum)
+    {
+        if constexpr (Distribution == ShardDistribution::NumaNode)
+            return CpuTopology::Instance().Nodes();
+        else
+            return threadNum;
+    }
+
+    unsigned int OwnIndex()
+    {
+        if constexpr (Distribution == ShardDistribution::NumaNode)
+            return static_cast < unsigned int >(CpuTopology::Instance().CurrentNode()) % m_count;
+
+        int index = WorkerIndex::Get();
+        if (index >= 0) return static_cast < unsigned int >(index) % m_count;
+
+        return FastRandom() % m_count;
+    }
+
+    unsigned int ProducerIndex()
+    {
+        if constexpr (Distribution == ShardDistribution::NumaNode)
+            return OwnIndex();
+
+        int index = WorkerIndex::Get();
+        if (index >= 0) return static_cast < unsigned int >(index) % m_count;
+
+        if constexpr (Distribution == ShardDistribution::ProducerHash)
+        {
+            static thread_local size_t s_hash = std::hash < std::thread::id >()(std::this_thread::get_id());
+            return static_cast < unsigned int >(s_hash % m_count);
+        }
+        else
+            return m_next.fetch_add(1, std::memory_order_relaxed) % m_count;
+    }
+
+    Shard& Best()
+    {
+        unsigned int best = FastRandom() % m_count;
+        for (unsigned int i = 0; i < m_count; ++i)
+        {
+            if (m_shards[i].Top() > m_shards[best].Top())
+                best = i;
+        }
+
+        return m_shards[best];
+    }
+
+    void Push(DataPtrType&& d)
+    {
+        m_shards[ProducerIndex()].Push(std::move(d));
+        m_size.fetch_add(1, std::memory_order_release);
+    }
+
+    unsigned int m_count;
+    std::unique_ptr < Shard[] > m_shards;
+    std::atomic < unsigned int > m_next;
+    alignas(64) std::atomic < size_t > m_size;
+};
+
+template < typename DataType >
+using ShardedPriorityQueue = BasicShardedPriorityQueue < DataType, ShardDistribution::RoundRobin >;
+
+template < typename DataType >
+using HashedShardedPriorityQueue = BasicShardedPriorityQueue < DataType, ShardDistribution::ProducerHash >;
+
+template < typename DataType >
+using NodeLocalPriorityQueue = BasicShardedPriorityQueue < DataType, ShardDistribution::NumaNode >;
+
+#endif // __SHARDED_PRIORITY_QUEUE_H__
@@ -0,0 +1,238 @@
+#if !defined( __STAGING_H__ )
+#define __STAGING_H__
+
+#include "Policy.h"
+
+// A staging buffer the flusher can expire; returns when it next has to look,
+// MonotonicNs() time, or std::numeric_limits< long long >::max() when empty.
+class StagedItems
+{
+public:
+    virtual long long Expire(long long now) = 0;
+
+protected:
+    ~StagedItems() = default;
+};
+
+// One thread flushing staging buffers whose oldest item waited for their
+// maxDelay, so a producer going idle does not hold its items back. It sleeps
+// until the earliest such deadline, and a buffer only arms it when its first
+// item is staged, i.e. at most once per flush.
+class StagingFlusher
+{
+    static constexpr long long Never = std::numeric_limits < long long >::max();
+public:
+    static StagingFlusher& Instance()
+    {
+        static StagingFlusher s_flusher;
+        return s_flusher;
+    }
+
+    void Register(StagedItems* buffer)
+    {
+        std::unique_lock < std::mutex > lk(m_l);
+        m_buffers.push_back(buffer);
+    }
+
+    // Once it returns the flusher no longer looks at the buffer.
+    void Unregister(StagedItems* buffer)
+    {
+        std::unique_lock < std::mutex > lk(m_l);
+        m_buffers.erase(std::remove(std::begin(m_buffers), std::end(m_buffers), buffer), std::end(m_buffers));
+    }
+
+    void Arm(long long due)
+    {
+        std::unique_lock < std::mutex > lk(m_l);
+        if (due >= m_next) return;
+
+        m_next = due;
+        m_wake.notify_one();
+    }
+
+    ~StagingFlusher()
+    {
+        {
+            std::unique_lock < std::mutex > lk(m_l);
+            m_stopping = true;
+            m_wake.notify_one();
+        }
+        m_thread.join();
+    }
+
+private:
+    StagingFlusher()
+    : m_next(Never)
+    , m_stopping(false)
+    , m_thread(&StagingFlusher::Run, this)
+    {}
+
+    // Buffers are expired under the flusher's lock, so Unregister waits for a
+    // pass using the buffer; Arm is called without the buffer's lock held.
+    void Run()
+    {
+        std::unique_lock < std::mutex > lk(m_l);
+        while (!m_stopping)
+        {
+            long long now = MonotonicNs();
+            if (m_next > now)
+            {
+                if (m_next == Never)
+                    m_wake.wait(lk);
+                else
+                    m_wake.wait_for(lk, std::chrono::nanoseconds(m_next - now));
+                continue;
+            }
+
+            m_next = Never;
+            for (StagedItems* buffer : m_buffers)
+                m_next = std::min(m_next, buffer->Expire(now));
+        }
+    }
+
+    std::mutex m_l;
+    std::condition_variable m_wake;
+    std::vector < StagedItems* > m_buffers;
+    long long m_next;
+    bool m_stopping;
+    std::thread m_thread;
+};
+
+// Producer-side buffer in front of an AsyncWorkPolicy. Each producer thread owns
+// one and stages its items in it, so most submissions touch only that thread's
+// memory; the items reach the shared queue in one PerformBatch, taking the queue
+// lock and signalling the workers once per flush.
+//
+// The buffer is flushed when it holds capacity items, when its oldest item has
+// waited for maxDelay, when an item of bypassPriority or higher arrives, on
+// Flush() and on destruction. Staging therefore delays an item by at most
+// capacity - 1 further submissions or maxDelay, whichever comes first, and never
+// delays items at or above bypassPriority. The delay is checked on submission
+// and by the StagingFlusher thread, which covers a producer going idle; its
+// wake-up latency comes on top of maxDelay. The buffer's lock is only contended
+// while the flusher expires it. Items the policy refuses, e.g. once it stopped,
+// are counted in Refused().
+template < typename PolicyType >
+class StagingBuffer final : public StagedItems
+{
+    static constexpr long long Never = std::numeric_limits < long long >::max();
+public:
+    using DataPtrType = typename PolicyType::DataPtrType;
+
+    StagingBuffer(PolicyType& policy, int capacity = 64,
+        std::chrono::microseconds maxDelay = std::chrono::microseconds(100),
+        int bypassPriority = std::numeric_limits < int >::max())
+    : m_policy(policy)
+    , m_capacity(static_cast < size_t >(std::max(capacity, 1)))
+    , m_max_delay(std::chrono::duration_cast < std::chrono::nanoseconds >(maxDelay).count())
+    , m_bypass_priority(bypassPriority)
+    , m_oldest(0)
+    , m_refused(0)
+    {
+        m_items.reserve(m_capacity);
+        StagingFlusher::Instance().Register(this);
+    }
+
+    StagingBuffer(const StagingBuffer&) = delete;
+    StagingBuffer& operator=(const StagingBuffer&) = delete;
+
+    ~StagingBuffer()
+    {
+        StagingFlusher::Instance().Unregister(this);
+        Flush();
+    }
+
+    void Perform(const DataPtrType& dataPtr)
+    {
+        Stage(DataPtrType(dataPtr));
+    }
+
+    void Perform(DataPtrType&& dataPtr)
+    {
+        Stage(std::move(dataPtr));
+    }
+
+    template < typename ... Args >
+    void Emplace(Args&& ... args)
+    {
+        Stage(m_policy.Make(std::forward < Args >(args) ...));
+    }
+
+    // Returns how many of the staged items the policy refused.
+    int Flush()
+    {
+        std::unique_lock < std::mutex > lk(m_l);
+        return FlushLocked();
+    }
+
+    // Items refused by all flushes so far, including those done on submission
+    // and by the flusher.
+    unsigned long Refused() const
+    {
+        std::unique_lock < std::mutex > lk(m_l);
+        return m_refused;
+    }
+
+    size_t Size() const
+    {
+        std::unique_lock < std::mutex > lk(m_l);
+        return m_items.size();
+    }
+
+    long long Expire(long long now) override
+    {
+        std::unique_lock < std::mutex > lk(m_l);
+        if (m_items.empty()) return Never;
+        if (now - m_oldest < m_max_delay) return m_oldest + m_max_delay;
+
+        FlushLocked();
+        return Never;
+    }
+
+private:
+    void Stage(DataPtrType&& dataPtr)
+    {
+        bool urgent = ItemRef(dataPtr).GetPriority() >= m_bypass_priority;
+        long long now = MonotonicNs();
+        bool first = false;
+        {
+            std::unique_lock < std::mutex > lk(m_l);
+
+            first = m_items.empty();
+            if (first) m_oldest = now;
+            m_items.push_back(std::move(dataPtr));
+
+            if (urgent || m_items.size() >= m_capacity || now - m_oldest >= m_max_delay)
+            {
+                FlushLocked();
+                return;
+            }
+        }
+
+        if (first)
+            StagingFlusher::Instance().Arm(now + m_max_delay);
+    }
+
+    int FlushLocked()
+    {
+        if (m_items.empty()) return 0;
+
+        int queued = m_policy.PerformBatch(std::make_move_iterator(std::begin(m_items)), std::make_move_iterator(std::end(m_items)));
+        int refused = static_cast < int >(m_items.size()) - queued;
+        m_refused += static_cast < unsigned long >(refused);
+        m_items.clear();
+
+        return refused;
+    }
+
+    PolicyType& m_policy;
+    size_t m_capacity;
+    long long m_max_delay;
+    int m_bypass_priority;
+    long long m_oldest;
+    unsigned long m_refused;
+    std::vector < DataPtrType > m_items;
+    mutable std::mutex m_l;
+};
+
+#endif // __STAGING_H__
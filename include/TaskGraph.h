@@ -0,0 +1,399 @@
+#if !defined( __TASK_GRAPH_H__ )
+#define __TASK_GRAPH_H__
+
+#include "Policy.h"
+
+// Opt-in graph rank; use Completable< Ranked< Data > > as the policy's DataType
+// and TaskGraph sets each item's priority to the length of its critical path.
+// Outside a graph an item keeps the priority of Data.
+template < typename DataType >
+class Ranked : public DataType
+{
+    int m_rank;
+public:
+    template < typename ... Args >
+    Ranked(Args&& ... args)
+    : DataType(std::forward < Args >(args) ...)
+    , m_rank(DataType::GetPriority())
+    {}
+
+    void SetRank(int rank) { m_rank = rank; }
+    int GetPriority() const { return m_rank; }
+};
+
+template < typename DataType, typename = void >
+struct HasRank : std::false_type {};
+
+template < typename DataType >
+struct HasRank < DataType, std::void_t < decltype(std::declval < DataType& >().SetRank(0)) > > : std::true_type {};
+
+// Items with dependencies between them, run on an AsyncWorkPolicy whose items
+// are Completable. Add returns a node id and Precede orders two nodes; Freeze
+// checks for cycles, lays the edges out in one array and ranks every node by
+// the cost of the longest path from it to the end of the graph, so with a
+// priority queue the critical path is served first.
+//
+// Run submits the nodes without predecessors; each completion counts down the
+// in-degree of its successors on the worker that ran it and submits those that
+// reach zero. A frozen graph runs any number of times, one run at a time, and a
+// run that succeeds allocates nothing beyond what Submit does. When a callback
+// throws or an item is refused, nodes not yet submitted are skipped and Wait
+// rethrows. Successors are submitted from the workers, so a bounded Block queue
+// must have room for Window items.
+//
+// Every submitted node holds a completion slot until its successors are out,
+// so at most Window nodes are submitted at a time and further ready nodes wait
+// for one of them to finish. Window stays well below the slot pool's capacity.
+template < typename PolicyType, int Window = 1024 >
+class TaskGraph
+{
+public:
+    using DataPtrType = typename PolicyType::DataPtrType;
+
+    TaskGraph(PolicyType& policy)
+    : m_policy(policy)
+    , m_frozen(false)
+    , m_running(false)
+    , m_failed(false)
+    , m_remaining(0)
+    , m_inflight(0)
+    , m_finished(true)
+    {
+        static_assert(PolicyType::Completes, "TaskGraph needs Completable< Data, ResultType > items.");
+    }
+
+    TaskGraph(const TaskGraph&) = delete;
+    TaskGraph& operator= (const TaskGraph&) = delete;
+
+    ~TaskGraph()
+    {
+        Wait(std::nothrow);
+    }
+
+    // Cost is what the node adds to the critical path of its predecessors.
+    int Add(DataPtrType dataPtr, int cost = 1)
+    {
+        assert(!m_running);
+        m_frozen = false;
+        m_items.push_back(std::move(dataPtr));
+        m_costs.push_back(std::max(cost, 0));
+        return static_cast < int >(m_items.size() - 1);
+    }
+
+    void Precede(int before, int after)
+    {
+        assert(!m_running);
+        assert(before >= 0 && after >= 0 && before != after);
+        assert(static_cast < size_t >(std::max(before, after)) < m_items.size());
+        m_frozen = false;
+        m_edges.emplace_back(before, after);
+    }
+
+    void Freeze()
+    {
+        assert(!m_running);
+        if (m_frozen) return;
+
+        int nodes = static_cast < int >(m_items.size());
+
+        // Successors of node n are m_successors[m_offsets[n] .. m_offsets[n + 1]).
+        m_offsets.assign(nodes + 1, 0);
+        m_indegree.assign(nodes, 0);
+        for (const std::pair < int, int >& edge : m_edges)
+        {
+            ++m_offsets[edge.first + 1];
+            ++m_indegree[edge.second];
+        }
+
+        for (int n = 0; n < nodes; ++n)
+            m_offsets[n + 1] += m_offsets[n];
+
+        m_successors.resize(m_edges.size());
+        std::vector < int > fill(std::begin(m_offsets), std::end(m_offsets) - 1);
+        for (const std::pair < int, int >& edge : m_edges)
+            m_successors[fill[edge.first]++] = edge.second;
+
+        // Kahn's order; ranks are then filled in backwards from the sinks.
+        std::vector < int > order;
+        std::vector < int > indegree(m_indegree);
+        order.reserve(nodes);
+        for (int n = 0; n < nodes; ++n)
+            if (!indegree[n]) order.push_back(n);
+
+        for (size_t i = 0; i < order.size(); ++i)
+            for (int s = m_offsets[order[i]]; s < m_offsets[order[i] + 1]; ++s)
+                if (!--indegree[m_successors[s]]) order.push_back(m_successors[s]);
+
+        if (order.size() != m_items.size())
+            throw std::invalid_argument("task graph has a cycle");
+
+        m_ranks.assign(nodes, 0);
+        for (auto it = order.rbegin(); it != order.rend(); ++it)
+        {
+            long long rank = 0;
+            for (int s = m_offsets[*it]; s < m_offsets[*it + 1]; ++s)
+                rank = std::max < long long >(rank, m_ranks[m_successors[s]]);
+
+            m_ranks[*it] = static_cast < int >(std::min < long long >(rank + m_costs[*it], std::numeric_limits < int >::max()));
+            if constexpr (HasRank < DataType >::value)
+                ItemRef(m_items[*it]).SetRank(m_ranks[*it]);
+        }
+
+        // Sources go out longest path first.
+        m_sources.clear();
+        for (int n : order)
+            if (!m_indegree[n]) m_sources.push_back(n);
+        std::stable_sort(std::begin(m_sources), std::end(m_sources), [this](int lhs, int rhs) { return m_ranks[lhs] > m_ranks[rhs]; });
+
+        m_pending.reset(new std::atomic < int >[nodes]);
+        m_parked.reserve(nodes);
+        m_links.assign(nodes, Nil);
+        m_frozen = true;
+    }
+
+    // Freezes the graph first if it changed since the last run.
+    void Run()
+    {
+        Wait(std::nothrow);
+        Freeze();
+
+        int nodes = static_cast < int >(m_items.size());
+        for (int n = 0; n < nodes; ++n)
+            m_pending[n].store(m_indegree[n], std::memory_order_relaxed);
+
+        m_error = nullptr;
+        m_failed.store(false, std::memory_order_relaxed);
+        m_remaining.store(nodes, std::memory_order_relaxed);
+        m_running = nodes > 0;
+        m_finished = !m_running;
+
+        for (int n : m_sources)
+            Ready(n);
+    }
+
+    // Blocks until the run is over and rethrows the first error it met.
+    void Wait()
+    {
+        Wait(std::nothrow);
+        if (m_error) std::rethrow_exception(m_error);
+    }
+
+    bool Running() const
+    {
+        return m_remaining.load(std::memory_order_acquire) != 0;
+    }
+
+    size_t Size() const
+    {
+        return m_items.size();
+    }
+
+    // Valid after Freeze: the critical path cost from a node to the end.
+    int Rank(int node) const
+    {
+        return m_ranks[node];
+    }
+
+private:
+    using DataType = std::remove_reference_t < decltype(ItemRef(std::declval < DataPtrType& >())) >;
+    using CompletionType = typename PolicyType::CompletionType;
+
+    static constexpr int Nil = -1;
+
+    // Nodes waiting to be started by the outermost Start on this thread.
+    struct Trampoline
+    {
+        TaskGraph* graph;
+        int head;
+    };
+
+    static Trampoline& Local()
+    {
+        static thread_local Trampoline s_local { nullptr, Nil };
+        return s_local;
+    }
+
+    struct Release
+    {
+        TaskGraph* self;
+        int node;
+        void operator()(CompletionType&& completion) const { self->Finished(node, completion); }
+    };
+
+    void Wait(std::nothrow_t)
+    {
+        if (!m_running) return;
+
+        std::unique_lock < std::mutex > lk(m_lock);
+        m_done.wait(lk, [this]() { return m_finished; });
+        m_running = false;
+    }
+
+    void Ready(int node)
+    {
+        {
+            std::unique_lock < std::mutex > lk(m_lock);
+            if (m_inflight == Window)
+            {
+                m_parked.push_back(node);
+                return;
+            }
+
+            ++m_inflight;
+        }
+
+        if (!Start(node)) Handoff();
+    }
+
+    // Called with a window place taken; false when the node was skipped and the
+    // place is free again. When an item finished before Then, its continuation
+    // runs inside Then and starts the successors right away. Those are queued on
+    // the thread here instead and started one after the other by the outermost
+    // Start, so neither the stack nor the completion slots held grow along a chain.
+    bool Start(int node)
+    {
+        Trampoline& local = Local();
+        if (local.graph == this)
+        {
+            m_links[node] = local.head;
+            local.head = node;
+            return true;
+        }
+
+        Trampoline outer = local;
+        local = Trampoline { this, Nil };
+
+        bool started = Submit(node);
+        while (local.head != Nil)
+        {
+            int next = local.head;
+            local.head = m_links[next];
+            if (!Submit(next)) Handoff();
+        }
+
+        local = outer;
+        return started;
+    }
+
+    bool Submit(int node)
+    {
+        if (m_failed.load(std::memory_order_relaxed))
+        {
+            Skip(node);
+            return false;
+        }
+
+        CompletionType completion = m_policy.Submit(static_cast < const DataPtrType& >(m_items[node]));
+        if (!completion.Valid())
+        {
+            Fail(std::make_exception_ptr(std::runtime_error("task graph item refused")));
+            Skip(node);
+            return false;
+        }
+
+        completion.Then(Release { this, node });
+        return true;
+    }
+
+    // Passes a freed window place on to a waiting node.
+    void Handoff()
+    {
+        for (;;)
+        {
+            int node;
+            {
+                std::unique_lock < std::mutex > lk(m_lock);
+                if (m_parked.empty())
+                {
+                    --m_inflight;
+                    return;
+                }
+
+                node = m_parked.back();
+                m_parked.pop_back();
+            }
+
+            if (Start(node)) return;
+        }
+    }
+
+    void Finished(int node, const CompletionType& completion)
+    {
+        if (completion.State() != CompletionState::Done)
+        {
+            try
+            {
+                completion.Get();
+            }
+            catch (...)
+            {
+                Fail(std::current_exception());
+            }
+        }
+
+        for (int s = m_offsets[node]; s < m_offsets[node + 1]; ++s)
+            if (m_pending[m_successors[s]].fetch_sub(1, std::memory_order_acq_rel) == 1)
+                Ready(m_successors[s]);
+
+        Handoff();
+        Done();
+    }
+
+    // Counts a node and everything only it was holding back as done, without running them.
+    void Skip(int node)
+    {
+        std::vector < int > skipped(1, node);
+        while (!skipped.empty())
+        {
+            int n = skipped.back();
+            skipped.pop_back();
+
+            for (int s = m_offsets[n]; s < m_offsets[n + 1]; ++s)
+                if (m_pending[m_successors[s]].fetch_sub(1, std::memory_order_acq_rel) == 1)
+                    skipped.push_back(m_successors[s]);
+
+            Done();
+        }
+    }
+
+    void Fail(std::exception_ptr error)
+    {
+        std::unique_lock < std::mutex > lk(m_lock);
+        if (!m_error) m_error = error;
+        m_failed.store(true, std::memory_order_relaxed);
+    }
+
+    // The graph may be gone once m_lock is released after the last node.
+    void Done()
+    {
+        if (m_remaining.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+
+        std::unique_lock < std::mutex > lk(m_lock);
+        m_finished = true;
+        m_done.notify_all();
+    }
+
+    PolicyType& m_policy;
+    std::vector < DataPtrType > m_items;
+    std::vector < int > m_costs;
+    std::vector < std::pair < int, int > > m_edges;
+    std::vector < int > m_offsets;
+    std::vector < int > m_successors;
+    std::vector < int > m_indegree;
+    std::vector < int > m_ranks;
+    std::vector < int > m_sources;
+    std::unique_ptr < std::atomic < int >[] > m_pending;
+    std::vector < int > m_parked;
+    std::vector < int > m_links;
+    bool m_frozen;
+    bool m_running;
+    std::atomic < bool > m_failed;
+    std::atomic < int > m_remaining;
+    int m_inflight;
+    bool m_finished;
+    std::exception_ptr m_error;
+    std::mutex m_lock;
+    std::condition_variable m_done;
+};
+
+#endif // __TASK_GRAPH_H__
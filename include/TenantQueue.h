@@ -0,0 +1,280 @@
+#if !defined( __TENANT_QUEUE_H__ )
+#define __TENANT_QUEUE_H__
+
+#include "Policy.h"
+
+// Opt-in tenant class; use Tenanted< Data > as the policy's DataType. Any item
+// type with a GetTenant() works the same way, items without one are class 0.
+template < typename DataType >
+class Tenanted : public DataType
+{
+    int m_tenant;
+public:
+    template < typename ... Args >
+    Tenanted(Args&& ... args)
+    : DataType(std::forward < Args >(args) ...)
+    , m_tenant(0)
+    {}
+
+    void SetTenant(int tenant) { m_tenant = tenant; }
+    int GetTenant() const { return m_tenant; }
+};
+
+template < typename DataType, typename = void >
+struct HasTenant : std::false_type {};
+
+template < typename DataType >
+struct HasTenant < DataType, std::void_t < decltype(std::declval < const DataType& >().GetTenant()) > > : std::true_type {};
+
+// Share and concurrency limit per class, like ThreadNumber types: Weight is how
+// many items a class may take in a row, Cap how many of its callbacks may run
+// at once.
+struct EqualTenants
+{
+    static int Weight(int) { return 1; }
+    static int Cap(int) { return std::numeric_limits < int >::max(); }
+};
+
+struct TenantStats
+{
+    unsigned long enqueued;
+    unsigned long dispatched;
+    size_t pending;
+    int running;
+    unsigned long throttled;
+
+    std::string Printout() const
+    {
+        std::stringstream sstm;
+        sstm << "enqueued: " << enqueued << ", dispatched: " << dispatched << ", pending: " << pending
+             << ", running: " << running << ", throttled: " << throttled << ".";
+        return sstm.str();
+    }
+};
+
+// One priority queue per tenant class, served by weighted round robin: deficit
+// round robin with every item costing one. Classes with items sit in a ring and
+// the current one takes up to its weight in items before the ring moves on, so
+// picking the class is O(1) and priorities only order items within a class.
+// A class with Cap callbacks running leaves the ring until one of them returns;
+// AsyncWorkPolicy reports that through Finished, and the worker token spent on
+// finding only capped classes is handed back then.
+template < typename DataType, typename ItemType, int Classes, typename ConfigType >
+class BasicTenantQueue
+{
+    static_assert(Classes > 0, "at least one tenant class");
+public:
+    using DataPtrType = ItemType;
+    using ResultType = typename BasicPriorityQueue < DataType, ItemType >::ResultType;
+
+    BasicTenantQueue()
+    : m_tenants(new Tenant[Classes])
+    , m_current(Nil)
+    , m_credits(0)
+    , m_size(0)
+    , m_deferred(0)
+    {}
+
+    void Enqueue(const DataPtrType& d)
+    {
+        Push(DataPtrType(d));
+    }
+
+    void Enqueue(DataPtrType&& d)
+    {
+        Push(std::move(d));
+    }
+
+    template < typename ... Args >
+    void Emplace(Args&& ... args)
+    {
+        Push(DataPtrType(std::forward < Args >(args) ...));
+    }
+
+    ResultType Dequeue()
+    {
+        while (m_current != Nil)
+        {
+            int c = m_current;
+            Tenant& tenant = m_tenants[c];
+
+            if (Running(tenant) >= ConfigType::Cap(c))
+            {
+                tenant.throttled.fetch_add(1, std::memory_order_relaxed);
+                Leave(c, State::Throttled);
+                continue;
+            }
+
+            ResultType d = tenant.items.Dequeue();
+            tenant.pending.fetch_sub(1, std::memory_order_relaxed);
+            tenant.running.fetch_add(1, std::memory_order_relaxed);
+            tenant.dispatched.fetch_add(1, std::memory_order_relaxed);
+            --m_size;
+
+            if (!tenant.pending.load(std::memory_order_relaxed))
+                Leave(c, State::Idle);
+            else if (--m_credits <= 0)
+                MoveTo(tenant.next);
+
+            return d;
+        }
+
+        if (m_size) ++m_deferred;
+        return ResultType();
+    }
+
+    int ClassOf(const DataPtrType& d) const
+    {
+        if constexpr (HasTenant < DataType >::value)
+            return static_cast < int >(static_cast < unsigned int >(ItemRef(d).GetTenant()) % Classes);
+        else
+            return 0;
+    }
+
+    // A callback of class c returned. True when a worker token was held back for
+    // lack of runnable classes and should be signalled again; tokens are held
+    // back only while some class is throttled, so a later Finished comes.
+    bool Finished(int c)
+    {
+        Tenant& tenant = m_tenants[c];
+        tenant.running.fetch_sub(1, std::memory_order_relaxed);
+
+        if (tenant.state == State::Throttled && Running(tenant) < ConfigType::Cap(c))
+            Join(c);
+
+        if (!m_deferred || m_current == Nil) return false;
+
+        --m_deferred;
+        return true;
+    }
+
+    std::vector < TenantStats > Tenants() const
+    {
+        std::vector < TenantStats > stats;
+        for (int c = 0; c < Classes; ++c)
+        {
+            const Tenant& tenant = m_tenants[c];
+            stats.push_back(TenantStats
+            {
+                tenant.enqueued.load(std::memory_order_relaxed),
+                tenant.dispatched.load(std::memory_order_relaxed),
+                tenant.pending.load(std::memory_order_relaxed),
+                tenant.running.load(std::memory_order_relaxed),
+                tenant.throttled.load(std::memory_order_relaxed)
+            });
+        }
+
+        return stats;
+    }
+
+private:
+    static constexpr int Nil = -1;
+
+    enum class State
+    {
+        Idle,
+        Active,
+        Throttled
+    };
+
+    // Counters are written under the policy lock and atomic only to be read
+    // without it by Tenants().
+    struct Tenant
+    {
+        BasicPriorityQueue < DataType, ItemType > items;
+        State state = State::Idle;
+        int prev = Nil;
+        int next = Nil;
+        std::atomic < size_t > pending { 0 };
+        std::atomic < int > running { 0 };
+        std::atomic < unsigned long > enqueued { 0 };
+        std::atomic < unsigned long > dispatched { 0 };
+        std::atomic < unsigned long > throttled { 0 };
+    };
+
+    static int Running(const Tenant& tenant)
+    {
+        return tenant.running.load(std::memory_order_relaxed);
+    }
+
+    void Push(DataPtrType&& d)
+    {
+        int c = ClassOf(d);
+        Tenant& tenant = m_tenants[c];
+
+        tenant.items.Enqueue(std::move(d));
+        tenant.pending.fetch_add(1, std::memory_order_relaxed);
+        tenant.enqueued.fetch_add(1, std::memory_order_relaxed);
+        ++m_size;
+
+        if (tenant.state == State::Idle)
+        {
+            if (Running(tenant) < ConfigType::Cap(c))
+                Join(c);
+            else
+                tenant.state = State::Throttled;
+        }
+    }
+
+    // Joins the ring just before the current class, so it is served last.
+    void Join(int c)
+    {
+        Tenant& tenant = m_tenants[c];
+        tenant.state = State::Active;
+
+        if (m_current == Nil)
+        {
+            tenant.prev = tenant.next = c;
+            MoveTo(c);
+            return;
+        }
+
+        int tail = m_tenants[m_current].prev;
+        tenant.prev = tail;
+        tenant.next = m_current;
+        m_tenants[tail].next = c;
+        m_tenants[m_current].prev = c;
+    }
+
+    void Leave(int c, State state)
+    {
+        Tenant& tenant = m_tenants[c];
+        tenant.state = state;
+
+        if (tenant.next == c)
+        {
+            m_current = Nil;
+            return;
+        }
+
+        m_tenants[tenant.prev].next = tenant.next;
+        m_tenants[tenant.next].prev = tenant.prev;
+        if (m_current == c) MoveTo(tenant.next);
+    }
+
+    void MoveTo(int c)
+    {
+        m_current = c;
+        m_credits = std::max(ConfigType::Weight(c), 1);
+    }
+
+    std::unique_ptr < Tenant[] > m_tenants;
+    int m_current;
+    int m_credits;
+    size_t m_size;
+    int m_deferred;
+};
+
+// Tenants< Classes, ConfigType >::Queue plugs into AsyncWorkPolicy like
+// PriorityQueue; the policy's Queue().Tenants() reports the per class counters.
+template < int Classes, typename ConfigType = EqualTenants >
+struct Tenants
+{
+    template < typename DataType >
+    using Queue = BasicTenantQueue < DataType, std::shared_ptr < DataType >, Classes, ConfigType >;
+
+    template < typename DataType >
+    using ValueQueue = BasicTenantQueue < DataType, DataType, Classes, ConfigType >;
+};
+
+#endif // __TENANT_QUEUE_H__
@@ -0,0 +1,514 @@
+#if !defined( __TIMER_WHEEL_H__ )
+#define __TIMER_WHEEL_H__
+
+#include "Policy.h"
+
+// Identifies one pending timer; stale once the timer fired or was cancelled.
+struct TimerHandle
+{
+    unsigned int index = std::numeric_limits < unsigned int >::max();
+    unsigned int generation = 0;
+
+    bool Valid() const
+    {
+        return index != std::numeric_limits < unsigned int >::max();
+    }
+};
+
+// Hierarchical timer wheel over integer ticks: Levels wheels of 2^SlotBits slots,
+// each slot of level n spanning 2^(SlotBits * n) ticks. A timer sits in the
+// coarsest level its distance needs and moves down a level whenever the lower
+// wheel wraps around, so Add and Cancel are O(1) and each timer is touched at
+// most Levels times. Timers further out than the whole wheel wait in the last
+// level and are re-placed on their way down. Nodes are kept in one vector and
+// linked by index, freed nodes are reused.
+template < typename ItemType, int Levels = 4, int SlotBits = 8 >
+class TimerWheel
+{
+public:
+    static constexpr unsigned int Slots = 1u << SlotBits;
+    static constexpr long long Range = 1LL << (SlotBits * Levels);
+    static constexpr long long Never = std::numeric_limits < long long >::max();
+
+    explicit TimerWheel(long long now = 0)
+    : m_now(now)
+    , m_free(Nil)
+    , m_size(0)
+    {
+        m_heads.fill(Nil);
+        m_occupied.fill(0);
+    }
+
+    size_t Size() const
+    {
+        return m_size;
+    }
+
+    // First tick not expired yet.
+    long long Now() const
+    {
+        return m_now;
+    }
+
+    // A tick already past expires on the next Advance.
+    TimerHandle Add(ItemType&& item, long long tick)
+    {
+        unsigned int index = Allocate();
+        Node& node = m_nodes[index];
+        node.item.emplace(std::move(item));
+        node.tick = tick;
+
+        Link(index);
+        ++m_size;
+
+        return TimerHandle { index, node.generation };
+    }
+
+    bool Cancel(const TimerHandle& handle)
+    {
+        if (handle.index >= m_nodes.size()) return false;
+
+        Node& node = m_nodes[handle.index];
+        if (node.generation != handle.generation || !node.item) return false;
+
+        Unlink(handle.index);
+        Release(handle.index);
+        --m_size;
+
+        return true;
+    }
+
+    // Expires every tick up to and including tick, appending the items in the
+    // order of their slots. Empty stretches of the lowest wheel are skipped.
+    // Returns how many timers were expired or moved down.
+    size_t Advance(long long tick, std::vector < ItemType >& due)
+    {
+        if (!m_size)
+        {
+            m_now = std::max(m_now, tick + 1);
+            return 0;
+        }
+
+        size_t touched = 0;
+        while (m_now <= tick)
+        {
+            unsigned int index = static_cast < unsigned int >(m_now) & (Slots - 1);
+            if (!index) touched += Cascade();
+            touched += Expire(index, due);
+
+            int next = FindOccupied(0, index + 1);
+            long long step = static_cast < long long >((next < 0) ? Slots : static_cast < unsigned int >(next)) - index;
+            m_now = std::min(m_now + step, tick + 1);
+        }
+
+        return touched;
+    }
+
+    // Earliest tick at which Advance has something to do: a timer expiring or a
+    // slot to move down. Never when empty. A slot of a higher wheel moves down
+    // when its span starts, so the current one is only due at m_now if Advance
+    // stopped right on that start; otherwise it holds timers Link placed a full
+    // revolution ahead.
+    long long NextDue() const
+    {
+        if (!m_size) return Never;
+
+        long long next = Never;
+        for (int level = 0; level < Levels; ++level)
+        {
+            int shift = SlotBits * level;
+            long long span = m_now >> shift;
+            unsigned int current = static_cast < unsigned int >(span) & (Slots - 1);
+            bool started = !(m_now & ((1LL << shift) - 1));
+
+            long long start = span - current;
+            int found = FindOccupied(level, started ? current : current + 1);
+            if (found < 0)
+            {
+                // Slots behind the current one come round on the next revolution.
+                found = FindOccupied(level, 0);
+                if (found < 0) continue;
+
+                start += Slots;
+            }
+
+            next = std::min(next, (start + found) << shift);
+        }
+
+        return next;
+    }
+
+    // Empties the wheel, handing the items back in no particular order.
+    void TakeAll(std::vector < ItemType >& items)
+    {
+        for (unsigned int slot = 0; slot < Levels * Slots; ++slot)
+        {
+            for (unsigned int index = TakeSlot(slot); index != Nil;)
+            {
+                unsigned int next = m_nodes[index].next;
+                items.push_back(std::move(*m_nodes[index].item));
+                Release(index);
+                index = next;
+            }
+        }
+
+        m_size = 0;
+    }
+
+private:
+    static constexpr unsigned int Nil = std::numeric_limits < unsigned int >::max();
+
+    struct Node
+    {
+        std::optional < ItemType > item;
+        long long tick;
+        unsigned int prev;
+        unsigned int next;
+        unsigned int slot;
+        unsigned int generation;
+    };
+
+    unsigned int Allocate()
+    {
+        if (m_free == Nil)
+        {
+            m_nodes.push_back(Node { std::nullopt, 0, Nil, Nil, 0, 1 });
+            return static_cast < unsigned int >(m_nodes.size() - 1);
+        }
+
+        unsigned int index = m_free;
+        m_free = m_nodes[index].next;
+        return index;
+    }
+
+    void Release(unsigned int index)
+    {
+        Node& node = m_nodes[index];
+        node.item.reset();
+        ++node.generation;
+        node.next = m_free;
+        m_free = index;
+    }
+
+    void Link(unsigned int index)
+    {
+        Node& node = m_nodes[index];
+        long long delta = std::min(std::max(node.tick - m_now, 0LL), Range - 1);
+        long long tick = m_now + delta;
+
+        int level = 0;
+        while (level < Levels - 1 && (delta >> (SlotBits * (level + 1))))
+            ++level;
+
+        node.slot = static_cast < unsigned int >(level) * Slots + (static_cast < unsigned int >(tick >> (SlotBits * level)) & (Slots - 1));
+        node.prev = Nil;
+        node.next = m_heads[node.slot];
+
+        if (node.next != Nil) m_nodes[node.next].prev = index;
+        m_heads[node.slot] = index;
+        m_occupied[node.slot / 64] |= 1ULL << (node.slot % 64);
+    }
+
+    void Unlink(unsigned int index)
+    {
+        Node& node = m_nodes[index];
+        if (node.prev != Nil)
+            m_nodes[node.prev].next = node.next;
+        else
+            m_heads[node.slot] = node.next;
+
+        if (node.next != Nil) m_nodes[node.next].prev = node.prev;
+        if (m_heads[node.slot] == Nil) m_occupied[node.slot / 64] &= ~(1ULL << (node.slot % 64));
+    }
+
+    unsigned int TakeSlot(unsigned int slot)
+    {
+        unsigned int head = m_heads[slot];
+        m_heads[slot] = Nil;
+        m_occupied[slot / 64] &= ~(1ULL << (slot % 64));
+        return head;
+    }
+
+    // The lowest wheel wrapped: move the now current slot of each wheel above
+    // down, going further up only while those wrap as well.
+    size_t Cascade()
+    {
+        size_t moved = 0;
+        for (int level = 1; level < Levels; ++level)
+        {
+            unsigned int current = static_cast < unsigned int >(m_now >> (SlotBits * level)) & (Slots - 1);
+            for (unsigned int index = TakeSlot(static_cast < unsigned int >(level) * Slots + current); index != Nil; ++moved)
+            {
+                unsigned int next = m_nodes[index].next;
+                Link(index);
+                index = next;
+            }
+
+            if (current) break;
+        }
+
+        return moved;
+    }
+
+    size_t Expire(unsigned int slot, std::vector < ItemType >& due)
+    {
+        size_t touched = 0;
+        for (unsigned int index = TakeSlot(slot); index != Nil; ++touched)
+        {
+            Node& node = m_nodes[index];
+            unsigned int next = node.next;
+
+            if (node.tick <= m_now)
+            {
+                due.push_back(std::move(*node.item));
+                Release(index);
+                --m_size;
+            }
+            else
+                Link(index);
+
+            index = next;
+        }
+
+        return touched;
+    }
+
+    // First occupied slot of the level at or after from, -1 if none.
+    int FindOccupied(int level, unsigned int from) const
+    {
+        for (unsigned int word = from / 64; word < Slots / 64; ++word)
+        {
+            unsigned long long bits = m_occupied[static_cast < unsigned int >(level) * Slots / 64 + word];
+            if (word == from / 64) bits &= ~0ULL << (from % 64);
+            if (bits) return static_cast < int >(word * 64 + static_cast < unsigned int >(LowestSetBit(bits)));
+        }
+
+        return -1;
+    }
+
+    static_assert(SlotBits >= 6 && SlotBits * Levels < 63, "slots are tracked in 64-bit words");
+
+    long long m_now;
+    unsigned int m_free;
+    size_t m_size;
+    std::vector < Node > m_nodes;
+    std::array < unsigned int, Levels * Slots > m_heads;
+    std::array < unsigned long long, Levels * Slots / 64 > m_occupied;
+};
+
+// Wakes the timer thread at an absolute steady clock time, in ns; Never disarms.
+// Both are called with the stage lock held, Wait gives it up while sleeping.
+#if defined( __linux__ )
+
+class TimerAlarm
+{
+    int m_fd;
+public:
+    TimerAlarm()
+    : m_fd(timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC))
+    {
+        if (m_fd < 0) throw SystemException(errno);
+    }
+
+    TimerAlarm(const TimerAlarm&) = delete;
+    TimerAlarm& operator= (const TimerAlarm&) = delete;
+
+    ~TimerAlarm()
+    {
+        close(m_fd);
+    }
+
+    void Arm(long long ns)
+    {
+        itimerspec spec {};
+        if (ns != std::numeric_limits < long long >::max())
+        {
+            ns = std::max(ns, 1LL);
+            spec.it_value.tv_sec = static_cast < time_t >(ns / 1000000000);
+            spec.it_value.tv_nsec = static_cast < long >(ns % 1000000000);
+        }
+
+        timerfd_settime(m_fd, TFD_TIMER_ABSTIME, &spec, nullptr);
+    }
+
+    void Wait(std::unique_lock < std::mutex >& lk)
+    {
+        unsigned long long expirations;
+
+        lk.unlock();
+        ssize_t result = read(m_fd, &expirations, sizeof(expirations));
+        (void)result;
+        lk.lock();
+    }
+};
+
+#else
+
+class TimerAlarm
+{
+    std::condition_variable m_wake;
+    long long m_deadline;
+public:
+    TimerAlarm() : m_deadline(std::numeric_limits < long long >::max()) {}
+
+    void Arm(long long ns)
+    {
+        m_deadline = ns;
+        m_wake.notify_one();
+    }
+
+    void Wait(std::unique_lock < std::mutex >& lk)
+    {
+        if (m_deadline == std::numeric_limits < long long >::max())
+            m_wake.wait(lk);
+        else
+            m_wake.wait_until(lk, std::chrono::steady_clock::time_point(std::chrono::nanoseconds(m_deadline)));
+    }
+};
+
+#endif
+
+// Front stage holding items until a given time and then passing them on to the
+// policy's queue. One timer thread sleeps until the next tick with something
+// due and moves everything due by then with a single PerformBatch, so the
+// policy's workers never wait on timers. Items never run early and run at most
+// a tick (TickNs, 1ms by default) plus the timer thread's wake-up late.
+template < typename PolicyType, long long TickNs = 1000000 >
+class TimerStage
+{
+public:
+    using DataPtrType = typename PolicyType::DataPtrType;
+
+    TimerStage(PolicyType& policy)
+    : m_policy(policy)
+    , m_origin(MonotonicNs())
+    , m_armed(Never)
+    , m_stopping(false)
+    , m_refused(0)
+    , m_thread(&TimerStage::Run, this)
+    {}
+
+    TimerStage(const TimerStage&) = delete;
+    TimerStage& operator= (const TimerStage&) = delete;
+
+    ~TimerStage()
+    {
+        Stop();
+    }
+
+    // The returned handle is invalid once the stage stopped.
+    TimerHandle PerformAt(DataPtrType dataPtr, std::chrono::steady_clock::time_point when)
+    {
+        long long tick = TickOf(when);
+
+        std::unique_lock < std::mutex > lk(m_lock);
+        if (m_stopping) return TimerHandle();
+
+        TimerHandle handle = m_wheel.Add(std::move(dataPtr), tick);
+        if (tick < m_armed)
+        {
+            m_armed = tick;
+            m_alarm.Arm(TimeOf(tick));
+        }
+
+        return handle;
+    }
+
+    template < typename Rep, typename Period >
+    TimerHandle PerformAfter(DataPtrType dataPtr, std::chrono::duration < Rep, Period > delay)
+    {
+        return PerformAt(std::move(dataPtr), std::chrono::steady_clock::now() +
+            std::chrono::duration_cast < std::chrono::steady_clock::duration >(delay));
+    }
+
+    // False when the item was queued already or cancelled before.
+    bool Cancel(const TimerHandle& handle)
+    {
+        std::unique_lock < std::mutex > lk(m_lock);
+        return m_wheel.Cancel(handle);
+    }
+
+    size_t Pending() const
+    {
+        std::unique_lock < std::mutex > lk(m_lock);
+        return m_wheel.Size();
+    }
+
+    // Due items the policy refused, e.g. because it stopped first.
+    unsigned long Refused() const
+    {
+        return m_refused.load(std::memory_order_relaxed);
+    }
+
+    // Joins the timer thread and hands back the items still waiting.
+    std::vector < DataPtrType > Stop()
+    {
+        {
+            std::unique_lock < std::mutex > lk(m_lock);
+            m_stopping = true;
+            m_alarm.Arm(0);
+        }
+
+        if (m_thread.joinable()) m_thread.join();
+
+        std::vector < DataPtrType > pending;
+        std::unique_lock < std::mutex > lk(m_lock);
+        m_wheel.TakeAll(pending);
+
+        return pending;
+    }
+
+private:
+    static constexpr long long Never = std::numeric_limits < long long >::max();
+
+    void Run()
+    {
+        std::vector < DataPtrType > due;
+        std::unique_lock < std::mutex > lk(m_lock);
+
+        while (!m_stopping)
+        {
+            m_wheel.Advance((MonotonicNs() - m_origin) / TickNs, due);
+            if (!due.empty())
+            {
+                lk.unlock();
+                int queued = m_policy.PerformBatch(std::make_move_iterator(std::begin(due)), std::make_move_iterator(std::end(due)));
+                m_refused.fetch_add(due.size() - static_cast < size_t >(queued), std::memory_order_relaxed);
+                due.clear();
+                lk.lock();
+                continue;
+            }
+
+            m_armed = m_wheel.NextDue();
+            m_alarm.Arm(TimeOf(m_armed));
+            m_alarm.Wait(lk);
+        }
+    }
+
+    // Rounds up, so that an item is never due before its time.
+    long long TickOf(std::chrono::steady_clock::time_point when) const
+    {
+        long long ns = std::chrono::duration_cast < std::chrono::nanoseconds >(when.time_since_epoch()).count() - m_origin;
+        if (ns <= 0) return 0;
+
+        return ns / TickNs + ((ns % TickNs) ? 1 : 0);
+    }
+
+    long long TimeOf(long long tick) const
+    {
+        if (tick >= (Never - m_origin) / TickNs) return Never;
+        return m_origin + tick * TickNs;
+    }
+
+    PolicyType& m_policy;
+    long long m_origin;
+    mutable std::mutex m_lock;
+    TimerWheel < DataPtrType > m_wheel;
+    TimerAlarm m_alarm;
+    long long m_armed;
+    bool m_stopping;
+    std::atomic < unsigned long > m_refused;
+    std::thread m_thread;
+};
+
+#endif // __TIMER_WHEEL_H__
@@ -0,0 +1,249 @@
+#if !defined( __TOPOLOGY_H__ )
+#define __TOPOLOGY_H__
+
+#include "Policy.h"
+
+// How pool workers are placed on the CPUs the process may run on.
+// Compact fills one node before the next, Scatter deals workers out across the
+// nodes, both one CPU per worker and physical cores before their SMT siblings.
+// Node binds each worker to all CPUs of one node, nodes taken round-robin, so
+// every node gets its own group of workers.
+enum class Pinning
+{
+    None,
+    Compact,
+    Scatter,
+    Node
+};
+
+// cpuset is a Linux CPU list such as "0-7,16-23" restricting the placement; empty
+// means every CPU in the process affinity mask.
+struct PlacementOptions
+{
+    Pinning pinning;
+    std::string cpuset;
+};
+
+// Placement types are the thread pool's counterpart of ThreadNumber types.
+template < Pinning Mode >
+struct Pinned
+{
+    static PlacementOptions Get()
+    {
+        return PlacementOptions { Mode, std::string() };
+    }
+};
+
+using NoPlacement = Pinned < Pinning::None >;
+using CompactPlacement = Pinned < Pinning::Compact >;
+using ScatterPlacement = Pinned < Pinning::Scatter >;
+using NodePlacement = Pinned < Pinning::Node >;
+
+// CPUs and NUMA nodes of the machine, read once from /sys. Only CPUs in the
+// process affinity mask are kept, so taskset and cgroup cpusets are honoured.
+// Without the node directories (or off Linux) everything is one node.
+class CpuTopology
+{
+public:
+    static const CpuTopology& Instance()
+    {
+        static const CpuTopology s_topology;
+        return s_topology;
+    }
+
+    int Nodes() const
+    {
+        return static_cast < int >(m_node_cpus.size());
+    }
+
+    const std::vector < int >& NodeCpus(int node) const
+    {
+        return m_node_cpus[static_cast < size_t >(node)];
+    }
+
+    int NodeOf(int cpu) const
+    {
+        if (cpu < 0 || static_cast < size_t >(cpu) >= m_cpu_node.size()) return 0;
+        return m_cpu_node[static_cast < size_t >(cpu)];
+    }
+
+    // Node of the CPU the calling thread runs on right now.
+    int CurrentNode() const
+    {
+        if (Nodes() == 1) return 0;
+#if defined( __linux__ )
+        return NodeOf(sched_getcpu());
+#else
+        return 0;
+#endif
+    }
+
+    // CPUs each worker may run on, indexed by worker; empty when not pinned.
+    std::vector < std::vector < int > > Place(const PlacementOptions& options, int workers) const
+    {
+        std::vector < std::vector < int > > placement;
+        if (options.pinning == Pinning::None || workers <= 0) return placement;
+
+        std::vector < std::vector < int > > nodes;
+        for (const std::vector < int >& cpus : m_node_cpus)
+        {
+            std::vector < int > usable = Restrict(cpus, options.cpuset);
+            if (!usable.empty()) nodes.push_back(std::move(usable));
+        }
+
+        if (nodes.empty()) throw SystemException(EINVAL);
+
+        if (options.pinning == Pinning::Node)
+        {
+            for (int i = 0; i < workers; ++i)
+                placement.push_back(nodes[static_cast < size_t >(i) % nodes.size()]);
+            return placement;
+        }
+
+        std::vector < int > order;
+        if (options.pinning == Pinning::Compact)
+        {
+            for (const std::vector < int >& cpus : nodes)
+                order.insert(std::end(order), std::begin(cpus), std::end(cpus));
+        }
+        else
+        {
+            for (size_t i = 0; order.size() < CountCpus(nodes); ++i)
+            {
+                for (const std::vector < int >& cpus : nodes)
+                    if (i < cpus.size()) order.push_back(cpus[i]);
+            }
+        }
+
+        for (int i = 0; i < workers; ++i)
+            placement.push_back({ order[static_cast < size_t >(i) % order.size()] });
+
+        return placement;
+    }
+
+    // Parses the kernel's CPU list format, "0-3,8,10-11".
+    static std::vector < int > ParseList(const std::string& list)
+    {
+        std::vector < int > values;
+        std::stringstream ss(list);
+        std::string range;
+
+        while (std::getline(ss, range, ','))
+        {
+            if (range.find_first_of("0123456789") == std::string::npos) continue;
+
+            size_t dash = range.find('-');
+            int first = std::atoi(range.c_str());
+            int last = (dash == std::string::npos) ? first : std::atoi(range.c_str() + dash + 1);
+
+            for (int v = first; v <= last; ++v)
+                values.push_back(v);
+        }
+
+        return values;
+    }
+
+private:
+    CpuTopology()
+    {
+        std::vector < int > allowed = AllowedCpus();
+
+        std::vector < int > nodes = ParseList(ReadLine("/sys/devices/system/node/online"));
+        for (int node : nodes)
+        {
+            std::vector < int > cpus = ParseList(ReadLine("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"));
+            cpus.erase(std::remove_if(std::begin(cpus), std::end(cpus), [&allowed](int cpu)
+            {
+                return !std::binary_search(std::begin(allowed), std::end(allowed), cpu);
+            }), std::end(cpus));
+
+            if (!cpus.empty()) m_node_cpus.push_back(CoresFirst(cpus));
+        }
+
+        if (m_node_cpus.empty()) m_node_cpus.push_back(CoresFirst(allowed));
+
+        for (size_t node = 0; node < m_node_cpus.size(); ++node)
+        {
+            for (int cpu : m_node_cpus[node])
+            {
+                if (static_cast < size_t >(cpu) >= m_cpu_node.size()) m_cpu_node.resize(cpu + 1, 0);
+                m_cpu_node[static_cast < size_t >(cpu)] = static_cast < int >(node);
+            }
+        }
+
+        LogDebug("CPU topology: ", Nodes(), " node(s), ", allowed.size(), " CPU(s).");
+    }
+
+    static std::string ReadLine(const std::string& path)
+    {
+        std::ifstream file(path);
+        std::string line;
+        std::getline(file, line);
+        return line;
+    }
+
+    static std::vector < int > AllowedCpus()
+    {
+        std::vector < int > cpus;
+#if defined( __linux__ )
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (!sched_getaffinity(0, sizeof(set), &set))
+        {
+            for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+                if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+        }
+#endif
+        if (cpus.empty())
+        {
+            cpus.resize(std::max(std::thread::hardware_concurrency(), 1u));
+            std::iota(std::begin(cpus), std::end(cpus), 0);
+        }
+
+        return cpus;
+    }
+
+    // The first thread of every core, then the SMT siblings.
+    static std::vector < int > CoresFirst(const std::vector < int >& cpus)
+    {
+        std::vector < int > primary;
+        std::vector < int > siblings;
+
+        for (int cpu : cpus)
+        {
+            std::vector < int > threads = ParseList(ReadLine("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/thread_siblings_list"));
+            bool first = threads.empty() || threads.front() == cpu;
+            (first ? primary : siblings).push_back(cpu);
+        }
+
+        primary.insert(std::end(primary), std::begin(siblings), std::end(siblings));
+        return primary;
+    }
+
+    static std::vector < int > Restrict(const std::vector < int >& cpus, const std::string& cpuset)
+    {
+        if (cpuset.empty()) return cpus;
+
+        std::vector < int > wanted = ParseList(cpuset);
+        std::vector < int > usable;
+        std::copy_if(std::begin(cpus), std::end(cpus), std::back_inserter(usable), [&wanted](int cpu)
+        {
+            return std::find(std::begin(wanted), std::end(wanted), cpu) != std::end(wanted);
+        });
+
+        return usable;
+    }
+
+    static size_t CountCpus(const std::vector < std::vector < int > >& nodes)
+    {
+        size_t count = 0;
+        for (const std::vector < int >& cpus : nodes)
+            count += cpus.size();
+        return count;
+    }
+
+    std::vector < std::vector < int > > m_node_cpus;
+    std::vector < int > m_cpu_node;
+};
+
+#endif // __TOPOLOGY_H__
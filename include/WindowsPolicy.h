@@ -68,26 +68,56 @@ private:
     }
 };
 
+// The console control callback runs on a thread of its own; it only records the
+// code and sets an event, and WaitForStop on the main thread reports it.
 class WindowsProcessTerminationHandler final
 {
     static WindowsProcessTerminationHandler* s_self;
-    std::function<void (void)> m_callback;
+    HANDLE m_hEvent;
+    std::atomic < ULONG > m_code;
 
     static BOOL __stdcall ConsoleCtrlCallback(ULONG code)
     {
-        std::cerr << "Console control callback for code " << code << " raised." << std::endl;
-        s_self->m_callback();
+        s_self->m_code.store(code);
+        SetEvent(s_self->m_hEvent);
         return TRUE;
     }
 
 public:
-    WindowsProcessTerminationHandler(std::function<void (void)>&& callback)
-    : m_callback(callback)
+    WindowsProcessTerminationHandler()
+    : m_hEvent(CreateEvent(nullptr, TRUE, FALSE, nullptr))
+    , m_code(0)
     {
-        if (!SetConsoleCtrlHandler(&WindowsProcessTerminationHandler::ConsoleCtrlCallback, TRUE))
+        if (!m_hEvent)
             throw WindowsException(GetLastError());
 
         WindowsProcessTerminationHandler::s_self = this;
+
+        if (!SetConsoleCtrlHandler(&WindowsProcessTerminationHandler::ConsoleCtrlCallback, TRUE))
+            throw WindowsException(GetLastError());
+    }
+
+    ~WindowsProcessTerminationHandler()
+    {
+        SetConsoleCtrlHandler(&WindowsProcessTerminationHandler::ConsoleCtrlCallback, FALSE);
+        CloseHandle(m_hEvent);
+    }
+
+    // Blocks until a key is pressed or a console control event arrives; true for the latter.
+    bool WaitForStop()
+    {
+        HANDLE handles[2] = { GetStdHandle(STD_INPUT_HANDLE), m_hEvent };
+        ULONG res = WaitForMultipleObjects(2, handles, FALSE, INFINITE);
+        if (res == WAIT_FAILED) throw WindowsException(GetLastError());
+
+        if (res == WAIT_OBJECT_0 + 1)
+        {
+            std::cerr << "Console control callback for code " << m_code.load() << " raised." << std::endl;
+            return true;
+        }
+
+        std::cin.get();
+        return false;
     }
 };
 
@@ -139,7 +169,7 @@ public:
 
 class WindowsSynchronizer : public GenericSync < WindowsSynchronizer >
 {
-    volatile bool m_stopping;
+    std::atomic < bool > m_stopping;
     LONG m_threadNum;
     HANDLE m_hSem;
 
@@ -149,8 +179,9 @@ public:
     : m_stopping(false)
     , m_threadNum(std::forward < LONG >(a ...))
     {
-        std::cout << "Created Windows API semaphore." << std::endl;
-        m_hSem = CreateSemaphoreEx(nullptr, 0, INT_MAX, _T("WindowsPolicyDemoSemaphore"),
+        LogDebug("Created Windows API semaphore.");
+        // Unnamed, a policy may own more than one.
+        m_hSem = CreateSemaphoreEx(nullptr, 0, INT_MAX, nullptr,
             0, SEMAPHORE_MODIFY_STATE | SYNCHRONIZE);
         if (!m_hSem) throw WindowsException(GetLastError());
     }
@@ -162,7 +193,12 @@ public:
 
     void Signal()
     {
-        BOOL res = ReleaseSemaphore(m_hSem, 1, nullptr);
+        Signal(1);
+    }
+
+    void Signal(int count)
+    {
+        BOOL res = ReleaseSemaphore(m_hSem, count, nullptr);
         if (!res) throw WindowsException(GetLastError());
     }
 
@@ -171,7 +207,37 @@ public:
         ULONG res = WaitForSingleObject(m_hSem, INFINITE);
         if (res == WAIT_FAILED) throw WindowsException(GetLastError());
         assert(res == WAIT_OBJECT_0);
-        return m_stopping;
+
+        bool stopping = m_stopping.load();
+        if (stopping) Signal();
+        return stopping;
+    }
+
+    WaitResult WaitFor(std::chrono::nanoseconds timeout)
+    {
+        // Clamp below INFINITE, which would turn a long timeout into no timeout.
+        long long count = std::chrono::duration_cast < std::chrono::milliseconds >(timeout).count();
+        DWORD ms = static_cast < DWORD >(std::min < long long >(std::max < long long >(count, 0), INFINITE - 1));
+        ULONG res = WaitForSingleObject(m_hSem, ms);
+        if (res == WAIT_FAILED) throw WindowsException(GetLastError());
+        if (res == WAIT_TIMEOUT) return WaitResult::Timeout;
+
+        if (m_stopping)
+        {
+            Signal();
+            return WaitResult::Stopped;
+        }
+
+        return WaitResult::Acquired;
+    }
+
+    int TryAcquire(int max)
+    {
+        int count = 0;
+        while (count < max && !m_stopping && WaitForSingleObject(m_hSem, 0) == WAIT_OBJECT_0)
+            ++count;
+
+        return count;
     }
 
     void Stop()
@@ -188,22 +254,35 @@ class WindowsThreadPool : public GenericThreadPool< WindowsThreadPool< ThreadFun
     LONG m_threadNum;
     std::vector < HANDLE > m_thv;
     ThreadFunType m_thfn;
+    std::atomic < int > m_nextIndex;
 public:
+    template < typename OtherFunType >
+    using Rebind = WindowsThreadPool < OtherFunType >;
+
     WindowsThreadPool(LONG threadNum, ThreadFunType&& thfn)
     : m_threadNum(threadNum)
     , m_thfn(thfn)
+    , m_nextIndex(0)
     {
-        std::cout << m_threadNum << " working threads used." << std::endl;
+        LogDebug(m_threadNum, " working threads used.");
     }
 
     ~WindowsThreadPool()
     {
+        Join();
+        LogDebug("System based threading completed.");
+    }
+
+    void Join()
+    {
+        if (m_thv.empty()) return;
+
         ULONG count = static_cast<ULONG>(m_thv.size());
         PHANDLE handles = &m_thv[0];
 
         WaitForMultipleObjects(count, handles, TRUE, INFINITE);
         std::for_each(std::begin(m_thv), std::end(m_thv), [](HANDLE& h) {CloseHandle(h);});
-        std::cout << "System based threading completed." << std::endl;
+        m_thv.clear();
     }
 
     void Start()
@@ -226,6 +305,7 @@ private:
     static unsigned int __stdcall WindowsTheadPoolCallback(void* param)
     {
         WindowsThreadPool* self = static_cast<WindowsThreadPool*>(param);
+        WorkerIndex::Set(self->m_nextIndex++);
         self->m_thfn();
         return 0;
     }
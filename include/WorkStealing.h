@@ -0,0 +1,177 @@
+#if !defined( __WORK_STEALING_H__ )
+#define __WORK_STEALING_H__
+
+#include "HeapShard.h"
+
+// Per-worker deques split into priority bands (band = bit width of the priority).
+// Workers push and pop locally at the back and steal from the front of a random
+// sibling, preferring the sibling whenever it holds a higher band than their own.
+template < typename DataType > class WorkStealingQueue
+{
+public:
+    using DataPtrType = std::shared_ptr < DataType >;
+
+    static constexpr bool SelfSynchronized = true;
+    static constexpr int Bands = 32;
+
+    WorkStealingQueue(int threadNum)
+    : m_count(std::max(threadNum, 1))
+    , m_deques(new WorkerDeque[m_count])
+    , m_next(0)
+    , m_size(0)
+    {}
+
+    void Enqueue(const DataPtrType& d)
+    {
+        Push(DataPtrType(d));
+    }
+
+    void Enqueue(DataPtrType&& d)
+    {
+        Push(std::move(d));
+    }
+
+    DataPtrType Dequeue()
+    {
+        if (!ReserveItem(m_size)) return DataPtrType();
+
+        WorkerDeque* own = Own();
+        DataPtrType d;
+
+        for (unsigned int attempt = 0;; ++attempt)
+        {
+            unsigned int index = (attempt < m_count) ? FastRandom() % m_count : attempt % m_count;
+            WorkerDeque& victim = m_deques[index];
+
+            if (own && own->TopBand() >= victim.TopBand() && own->Pop(d, true))
+                return d;
+
+            if (victim.Pop(d, &victim == own))
+                return d;
+        }
+    }
+
+private:
+    struct alignas(64) WorkerDeque
+    {
+        SpinLock lock;
+        std::atomic < unsigned int > occupied { 0 };
+        std::deque < DataPtrType > bands[Bands];
+
+        int TopBand() const
+        {
+            unsigned int mask = occupied.load(std::memory_order_relaxed);
+            return mask ? HighestSetBit(mask) : -1;
+        }
+
+        void Push(DataPtrType&& d, int band)
+        {
+            ScopedLocker < SpinLock > l(lock);
+            bands[band].push_back(std::move(d));
+            occupied.store(occupied.load(std::memory_order_relaxed) | (1u << band), std::memory_order_relaxed);
+        }
+
+        bool Pop(DataPtrType& d, bool back)
+        {
+            ScopedLocker < SpinLock > l(lock);
+            unsigned int mask = occupied.load(std::memory_order_relaxed);
+            if (!mask) return false;
+
+            int band = HighestSetBit(mask);
+            std::deque < DataPtrType >& q = bands[band];
+            if (back)
+            {
+                d = std::move(q.back());
+                q.pop_back();
+            }
+            else
+            {
+                d = std::move(q.front());
+                q.pop_front();
+            }
+
+            if (q.empty())
+                occupied.store(mask & ~(1u << band), std::memory_order_relaxed);
+
+            return true;
+        }
+    };
+
+    static int Band(int priority)
+    {
+        return (priority > 0) ? std::min(HighestSetBit(static_cast < unsigned int >(priority)) + 1, Bands - 1) : 0;
+    }
+
+    WorkerDeque* Own()
+    {
+        int index = WorkerIndex::Get();
+        return (index >= 0 && static_cast < unsigned int >(index) < m_count) ? &m_deques[index] : nullptr;
+    }
+
+    void Push(DataPtrType&& d)
+    {
+        int band = Band(d->GetPriority());
+        WorkerDeque* target = Own();
+        if (!target)
+            target = &m_deques[m_next.fetch_add(1, std::memory_order_relaxed) % m_count];
+
+        target->Push(std::move(d), band);
+        m_size.fetch_add(1, std::memory_order_release);
+    }
+
+    unsigned int m_count;
+    std::unique_ptr < WorkerDeque[] > m_deques;
+    std::atomic < unsigned int > m_next;
+    alignas(64) std::atomic < size_t > m_size;
+};
+
+template < typename ThreadFunType = std::function<void(void)> >
+class WorkStealingThreadPool : public GenericThreadPool< WorkStealingThreadPool< ThreadFunType > >
+{
+    int m_thread_num;
+    std::list < std::thread > m_thl;
+    ThreadFunType m_thfn;
+public:
+    template < typename OtherFunType >
+    using Rebind = WorkStealingThreadPool < OtherFunType >;
+
+    WorkStealingThreadPool(int thread_num, ThreadFunType&& thfn)
+    : m_thread_num(thread_num)
+    , m_thfn(thfn)
+    {
+        LogDebug(m_thread_num, " work stealing threads used.");
+    }
+
+    ~WorkStealingThreadPool()
+    {
+        Join();
+        LogDebug("Work stealing threading completed.");
+    }
+
+    void Join()
+    {
+        std::for_each(std::begin(m_thl), std::end(m_thl), [](std::thread& th) { th.join (); });
+        m_thl.clear();
+    }
+
+    void Start()
+    {
+        for (int i = 0; i < m_thread_num; ++i)
+        {
+            m_thl.emplace_back([this, i]()
+            {
+                WorkerIndex::Set(i);
+                m_thfn();
+            });
+        }
+    }
+
+    static unsigned int GetCurrentThreadId()
+    {
+        std::stringstream sstm;
+        sstm << std::this_thread::get_id();
+        return std::stoul(sstm.str());
+    }
+};
+
+#endif // __WORK_STEALING_H__
@@ -1,5 +1,26 @@
 #define DEBUG_MODE      1
 #define USE_CRT_POLICY  0
+#define USE_CONCURRENT_QUEUE 0
+#define USE_FUTEX_SYNC 0
+#define USE_WORK_STEALING 0
+#define USE_SHARDED_QUEUE 0
+#define USE_OBJECT_POOL 0
+#define USE_VALUE_ITEMS 0
+#define USE_INLINE_CALLBACK 0
+#define USE_ADAPTIVE_SPIN 0
+#define USE_INSTRUMENTATION 0
+#define USE_STAGING 0
+#define USE_BOUNDED_QUEUE 0
+#define USE_BUCKET_QUEUE 0
+#define USE_DARY_HEAP 0
+#define USE_NUMA_PLACEMENT 0
+#define USE_ELASTIC_POOL 0
+#define USE_COMPLETION 0
+#define USE_TIMER_WHEEL 0
+#define USE_DEADLINE_QUEUE 0
+#define USE_TENANT_QUEUE 0
+#define USE_TASK_GRAPH 0
+#define USE_PARALLEL_LOOPS 0
 #define USE_SINGLETON   0
 
 #if defined( _WIN64 )
@@ -19,16 +40,101 @@ using CurrentProcessTerminationHandler = WindowsProcessTerminationHandler;
 
 #endif
 
+#if USE_TIMER_WHEEL==1
+#include "TimerWheel.h"
+#endif // USE_TIMER_WHEEL
+
+struct DefaultCallback
+{
+    template < typename ItemType >
+    void operator()(const ItemType& d) const
+    {
+        LogInfo("DefaultCallback - got entry - ", ItemRef(d));
+    }
+};
+
 #if USE_CRT_POLICY==1
 
 #include "CrtPolicy.h"
+#if USE_INLINE_CALLBACK==1
+using CurrentThreadPoolPolicy = CrtInlinePolicy<DefaultCallback>;
+#elif USE_VALUE_ITEMS==1
+using CurrentThreadPoolPolicy = CrtValuePolicy;
+#elif USE_OBJECT_POOL==1
+using CurrentThreadPoolPolicy = CrtPooledPolicy;
+#elif USE_SHARDED_QUEUE==1
+using CurrentThreadPoolPolicy = CrtShardedPolicy;
+#elif USE_WORK_STEALING==1
+using CurrentThreadPoolPolicy = CrtWorkStealingPolicy;
+#elif USE_CONCURRENT_QUEUE==1
+using CurrentThreadPoolPolicy = CrtConcurrentQueuePolicy;
+#elif USE_ADAPTIVE_SPIN==1
+using CurrentThreadPoolPolicy = CrtAdaptiveSpinPolicy;
+#elif USE_INSTRUMENTATION==1
+using CurrentThreadPoolPolicy = CrtInstrumentedPolicy;
+#elif USE_BOUNDED_QUEUE==1
+using CurrentThreadPoolPolicy = CrtBoundedPolicy;
+#elif USE_BUCKET_QUEUE==1
+using CurrentThreadPoolPolicy = CrtBucketPolicy;
+#elif USE_DARY_HEAP==1
+using CurrentThreadPoolPolicy = CrtDaryHeapPolicy;
+#elif USE_ELASTIC_POOL==1
+using CurrentThreadPoolPolicy = CrtElasticPolicy;
+#elif USE_COMPLETION==1
+using CurrentThreadPoolPolicy = CrtCompletionPolicy;
+#elif USE_DEADLINE_QUEUE==1
+using CurrentThreadPoolPolicy = CrtDeadlinePolicy;
+#elif USE_TENANT_QUEUE==1
+using CurrentThreadPoolPolicy = CrtTenantPolicy;
+#elif USE_TASK_GRAPH==1
+using CurrentThreadPoolPolicy = CrtGraphPolicy;
+#else
 using CurrentThreadPoolPolicy = CrtThreadPoolPolicy;
+#endif
 
 #else
 
 #if defined( __linux__ )
 
+#if USE_INLINE_CALLBACK==1
+using CurrentThreadPoolPolicy = LinuxInlinePolicy<DefaultCallback>;
+#elif USE_VALUE_ITEMS==1
+using CurrentThreadPoolPolicy = LinuxValuePolicy;
+#elif USE_OBJECT_POOL==1
+using CurrentThreadPoolPolicy = LinuxPooledPolicy;
+#elif USE_SHARDED_QUEUE==1
+using CurrentThreadPoolPolicy = LinuxShardedPolicy;
+#elif USE_WORK_STEALING==1
+using CurrentThreadPoolPolicy = LinuxWorkStealingPolicy;
+#elif USE_CONCURRENT_QUEUE==1
+using CurrentThreadPoolPolicy = LinuxConcurrentQueuePolicy;
+#elif USE_FUTEX_SYNC==1
+using CurrentThreadPoolPolicy = LinuxFutexPolicy;
+#elif USE_ADAPTIVE_SPIN==1
+using CurrentThreadPoolPolicy = LinuxAdaptiveSpinPolicy;
+#elif USE_INSTRUMENTATION==1
+using CurrentThreadPoolPolicy = LinuxInstrumentedPolicy;
+#elif USE_BOUNDED_QUEUE==1
+using CurrentThreadPoolPolicy = LinuxBoundedPolicy;
+#elif USE_BUCKET_QUEUE==1
+using CurrentThreadPoolPolicy = LinuxBucketPolicy;
+#elif USE_DARY_HEAP==1
+using CurrentThreadPoolPolicy = LinuxDaryHeapPolicy;
+#elif USE_NUMA_PLACEMENT==1
+using CurrentThreadPoolPolicy = LinuxNumaPolicy;
+#elif USE_ELASTIC_POOL==1
+using CurrentThreadPoolPolicy = LinuxElasticPolicy;
+#elif USE_COMPLETION==1
+using CurrentThreadPoolPolicy = LinuxCompletionPolicy;
+#elif USE_DEADLINE_QUEUE==1
+using CurrentThreadPoolPolicy = LinuxDeadlinePolicy;
+#elif USE_TENANT_QUEUE==1
+using CurrentThreadPoolPolicy = LinuxTenantPolicy;
+#elif USE_TASK_GRAPH==1
+using CurrentThreadPoolPolicy = LinuxGraphPolicy;
+#else
 using CurrentThreadPoolPolicy = LinuxThreadPoolPolicy;
+#endif
 
 #elif defined( _WIN64 )
 
@@ -111,6 +217,19 @@ public:
     int Run()
     {
         srand(time(nullptr));
+
+#if USE_STAGING==1
+        StagingBuffer < CurrentThreadPoolPolicy > producer(m_policy);
+#else
+        CurrentThreadPoolPolicy & producer = m_policy;
+#endif // USE_STAGING
+#if USE_COMPLETION==1
+        std::vector < CurrentThreadPoolPolicy::CompletionType > completions;
+#elif USE_TIMER_WHEEL==1
+        TimerStage < CurrentThreadPoolPolicy > timers(m_policy);
+#elif USE_TASK_GRAPH==1
+        TaskGraph < CurrentThreadPoolPolicy > graph(m_policy);
+#endif // USE_COMPLETION
         
         for (int i = 0; i < Maxval<DEBUG_MODE>::Get(); ++i)
         {
@@ -119,12 +238,49 @@ public:
             int a = (p << 2) + 1;
             int b = a - i;
 
-            m_policy.Perform(std::shared_ptr< Data >(new Data(a, b, p)));
+#if USE_COMPLETION==1
+            completions.push_back(producer.Submit(producer.Make(a, b, p)));
+#elif USE_TIMER_WHEEL==1
+            // Delay each entry by its secret number in milliseconds.
+            timers.PerformAfter(producer.Make(a, b, p), std::chrono::milliseconds(p));
+#elif USE_TASK_GRAPH==1
+            // Each entry waits for the one at half its index.
+            int node = graph.Add(producer.Make(a, b, p));
+            if (node) graph.Precede((node - 1) / 2, node);
+#else
+            producer.Emplace(a, b, p);
+#endif // USE_COMPLETION
         }
 
+#if USE_STAGING==1
+        producer.Flush();
+#endif // USE_STAGING
+
+#if USE_PARALLEL_LOOPS==1
+        // Sum of squares on the same workers, with this thread taking part.
+        std::vector < long long > squares(1 << 20);
+        m_policy.ParallelFor(0, static_cast < int >(squares.size()), [&squares](int i) { squares[i] = 1LL * i * i; });
+        std::cout << "Sum of squares: " << m_policy.ParallelReduce(std::begin(squares), std::end(squares), 0LL, std::plus < long long >()) << std::endl;
+#endif // USE_PARALLEL_LOOPS
+
+#if USE_COMPLETION==1
+        WaitAll(std::begin(completions), std::end(completions));
+        std::cout << "All " << completions.size() << " submitted tasks completed." << std::endl;
+#elif USE_TASK_GRAPH==1
+        graph.Run();
+        graph.Wait();
+        std::cout << "Task graph of " << graph.Size() << " entries completed." << std::endl;
+#endif // USE_COMPLETION
+
         std::cout << "Task in progress. Press any key to stop..." << std::endl;
-        std::cin.get();
 
+        // A termination signal stops the policy without draining, a key drains it for a second.
+        ShutdownOptions options = ShutdownOptions::Until(std::chrono::seconds(1));
+        if (m_processTerminationHandler.WaitForStop())
+            options = ShutdownOptions::Abort();
+
+        std::cout << m_policy.Snapshot().Printout();
+        std::cout << m_policy.Shutdown(options).Printout() << std::endl;
         m_policy.ShowExceptions();
 
         return 0;
@@ -132,12 +288,7 @@ public:
 
 private:
     ThreadedApp()
-    : m_policy(
-        [](const std::shared_ptr< Data > &d)
-        {
-            std::cout << "DefaultCallback - got entry - " << d->Printout () << std::endl;
-        })
-    , m_processTerminationHandler(std::bind(&CurrentThreadPoolPolicy::Stop, &m_policy))
+    : m_policy(DefaultCallback())
     {
         std::cout << "Creating threaded app." << std::endl;
     }